@@ -0,0 +1,119 @@
+// Times the bytecode VM on a call-heavy and an arithmetic-heavy script, to
+// compare dispatch strategies: run `make bench` and `make bench
+// DISPATCH=switch`. Parsing is not timed; compiling to bytecode is, but it
+// is the same work in both builds.
+//
+// Lizard has no conditionals, so recursion cannot stop by itself; the
+// call-heavy script instead runs a chain of functions, each calling the
+// one below it, CHAIN_DEPTH deep.
+
+#include "interpreter.h"
+#include "resolver.h"
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHAIN_DEPTH 32
+#define CHAIN_CALLS 20000
+#define ARITHMETIC_LINES 100
+#define ARITHMETIC_CALLS 20000
+#define RUNS 9
+
+static double elapsed_s(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+typedef struct {
+  char *text;
+  size_t length;
+  size_t capacity;
+} Source;
+
+static void append(Source *source, const char *format, int a, int b) {
+  if (source->capacity - source->length < 256) {
+    source->capacity = source->capacity ? source->capacity * 2 : 4096;
+    source->text = realloc(source->text, source->capacity);
+  }
+  source->length += (size_t)snprintf(source->text + source->length,
+                                     source->capacity - source->length,
+                                     format, a, b);
+}
+
+static Source generate_calls(void) {
+  Source source = {0};
+  append(&source, "fnc f0(int n) -> int {\n  return n + 1\n}\n", 0, 0);
+  for (int i = 1; i < CHAIN_DEPTH; i++) {
+    append(&source, "fnc f%d(int n) -> int {\n  return f%d(n + 1) * 1\n}\n",
+           i, i - 1);
+  }
+  append(&source, "let int: total = 0\n", 0, 0);
+  for (int i = 0; i < CHAIN_CALLS; i++) {
+    append(&source, "total = total + f%d(%d)\n", CHAIN_DEPTH - 1, i % 100);
+  }
+  return source;
+}
+
+static Source generate_arithmetic(void) {
+  Source source = {0};
+  append(&source, "fnc work(int a, int b) -> int {\n  let int: c = a * b\n", 0, 0);
+  append(&source, "  let float: x = 1.5\n", 0, 0);
+  for (int i = 0; i < ARITHMETIC_LINES; i++) {
+    append(&source, "  c = c * 3 + c %% 7 - b * b + a - %d\n", i, 0);
+    append(&source, "  x = x * 1.0001 + 0.5 - x / 3.0\n", 0, 0);
+  }
+  append(&source, "  return c\n}\nlet int: total = 0\n", 0, 0);
+  for (int i = 0; i < ARITHMETIC_CALLS; i++) {
+    append(&source, "total = total + work(%d, %d)\n", i, i + 1);
+  }
+  return source;
+}
+
+// Best of RUNS, each on a fresh interpreter so that quickening starts over.
+static double measure(const Source *source) {
+  double best = 0;
+
+  for (int run = 0; run < RUNS; run++) {
+    Lexer *lexer = lexer_create(source->text, source->length, "bench");
+    Arena *arena = arena_create();
+    Parser *parser = parser_create(lexer, arena);
+    ASTNode *program = parser_parse(parser);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    if (!program) {
+      fprintf(stderr, "benchmark script failed to parse\n");
+      exit(1);
+    }
+    resolver_resolve(program);
+
+    Interpreter *interpreter = interpreter_create();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    interpreter_run(interpreter, program);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = elapsed_s(start, end);
+    if (run == 0 || seconds < best) {
+      best = seconds;
+    }
+    interpreter_destroy(interpreter);
+    arena_destroy(arena);
+  }
+  return best;
+}
+
+int main(void) {
+  Source calls = generate_calls();
+  Source arithmetic = generate_arithmetic();
+
+  printf("VM dispatch: %s, best of %d runs\n", VM_DISPATCH_NAME, RUNS);
+  printf("calls       %d x %d-deep chain  %7.2f ms\n", CHAIN_CALLS,
+         CHAIN_DEPTH, measure(&calls) * 1e3);
+  printf("arithmetic  %d x %d lines      %7.2f ms\n", ARITHMETIC_CALLS,
+         ARITHMETIC_LINES * 2, measure(&arithmetic) * 1e3);
+
+  free(calls.text);
+  free(arithmetic.text);
+  return 0;
+}
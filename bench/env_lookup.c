@@ -0,0 +1,63 @@
+// Measures variable lookup cost as the number of names in scope grows.
+// Lookups start two scopes below the globals, the way a name used inside a
+// block of a function body is resolved.
+
+#include "environment.h"
+#include <stdio.h>
+#include <time.h>
+
+#define LOOKUPS 10000000
+
+static double elapsed_ns(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void bench_scope_size(int size) {
+  const Type *int_type = type_intern(symbol_intern("int"));
+  Environment *globals = environment_create(NULL);
+  Symbol **names = malloc(sizeof(Symbol *) * size);
+
+  for (int i = 0; i < size; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "global_%d", i);
+    names[i] = symbol_intern(name);
+    Value value = value_create_int(i);
+    environment_define_default(globals, names[i], &value, int_type);
+  }
+
+  Environment *function_env = environment_create(globals);
+  Environment *block_env = environment_create(function_env);
+  Value local = value_create_int(0);
+  environment_define_default(function_env, symbol_intern("local"), &local,
+                             int_type);
+
+  struct timespec start, end;
+  long long checksum = 0;
+  unsigned index = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < LOOKUPS; i++) {
+    // Stride through the table so lookups do not stay in one cache line.
+    index = (index + 7919) % (unsigned)size;
+    checksum += environment_get(block_env, names[index])->int_val;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("%8d names  %6.2f ns/lookup  (checksum %lld)\n", size,
+         elapsed_ns(start, end) / LOOKUPS, checksum);
+
+  environment_destroy(block_env);
+  environment_destroy(function_env);
+  environment_destroy(globals);
+  free(names);
+}
+
+int main(void) {
+  int sizes[] = {10, 100, 1000, 10000};
+
+  printf("Environment lookup, %d lookups per row\n", LOOKUPS);
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    bench_scope_size(sizes[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Measures lexer throughput on two generated scripts of roughly 10 MB each:
+// dense code mixing declarations, calls, string and format literals, and a
+// configuration-style script that is mostly indentation, comments and long
+// strings.
+
+#include "lexer.h"
+#include <stdio.h>
+#include <time.h>
+
+#define SOURCE_BYTES (10 * 1024 * 1024)
+#define ROUNDS 5
+
+static double elapsed_s(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static char *generate_code(size_t *length) {
+  char *source = malloc(SOURCE_BYTES + 1024);
+  size_t used = 0;
+
+  for (int i = 0; used < SOURCE_BYTES; i++) {
+    used += (size_t)snprintf(
+        source + used, SOURCE_BYTES + 1024 - used,
+        "# configuration block %d\n"
+        "fnc compute_%d(int value, scale = 2) -> int {\n"
+        "  let int: result = value * scale + %d %% 7\n"
+        "  return result\n"
+        "}\n"
+        "let label_%d = \"entry \\\"%d\\\" ready\"\n"
+        "println(\"value ${compute_%d(%d_000)} for ${label_%d}\")\n",
+        i, i, i, i, i, i, i, i);
+  }
+
+  *length = used;
+  return source;
+}
+
+static char *generate_config(size_t *length) {
+  char *source = malloc(SOURCE_BYTES + 1024);
+  size_t used = 0;
+
+  for (int i = 0; used < SOURCE_BYTES; i++) {
+    used += (size_t)snprintf(
+        source + used, SOURCE_BYTES + 1024 - used,
+        "###\n"
+        "    Section %d. Generated from the deployment manifest; edit the\n"
+        "    manifest instead of this file, changes here are overwritten.\n"
+        "###\n"
+        "\n"
+        "                                        # owner: platform team\n"
+        "let section_%d_name    =    \"service-%d.internal.example.com:8080\"\n"
+        "let section_%d_comment =    \"Handles requests routed from the edge "
+        "proxies in every region, see the runbook for failover steps\"\n"
+        "\n",
+        i, i, i, i);
+  }
+
+  *length = used;
+  return source;
+}
+
+static void measure(const char *name, char *(*generate)(size_t *)) {
+  size_t length;
+  char *source = generate(&length);
+  size_t tokens = 0;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int round = 0; round < ROUNDS; round++) {
+    Lexer *lexer = lexer_create(source, length, "bench.lz");
+    tokens = 0;
+    while (lexer_next_token(lexer).type != TOKEN_EOF)
+      tokens++;
+    lexer_destroy(lexer);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = elapsed_s(start, end) / ROUNDS;
+  printf("%-7s %.1f MB source, %zu tokens\n", name,
+         length / (1024.0 * 1024.0), tokens);
+  printf("%8.1f MB/s  %8.1f Mtokens/s\n", length / (1024.0 * 1024.0) / seconds,
+         tokens / 1e6 / seconds);
+
+  free(source);
+}
+
+int main(void) {
+  printf("Lexer throughput\n");
+  measure("code", generate_code);
+  measure("config", generate_config);
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Measures the cost of creating and dropping short-lived runtime objects:
+// string temporaries of a few sizes and heap scopes with a couple of
+// names. Build with `make bench POOL=0` to compare against plain malloc.
+
+#include "environment.h"
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS 10000000
+#define LIVE 64     // Temporaries kept alive at once, released oldest first
+
+static double elapsed_ns(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void bench_strings(size_t length) {
+  char text[256];
+  memset(text, 'x', sizeof(text));
+  String *live[LIVE] = {0};
+
+  struct timespec start, end;
+  size_t checksum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < ROUNDS; i++) {
+    String **slot = &live[i % LIVE];
+    if (*slot) {
+      checksum += (*slot)->length;
+      string_release(*slot);
+    }
+    *slot = string_create(text, length + (size_t)(i & 7));
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (int i = 0; i < LIVE; i++) {
+    if (live[i]) string_release(live[i]);
+  }
+  printf("string %4zu bytes  %6.2f ns/op  (checksum %zu)\n", length,
+         elapsed_ns(start, end) / ROUNDS, checksum);
+}
+
+static void bench_scopes(void) {
+  const Type *int_type = type_intern(symbol_intern("int"));
+  Symbol *a = symbol_intern("a"), *b = symbol_intern("b");
+  Environment *globals = environment_create(NULL);
+
+  struct timespec start, end;
+  long long checksum = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < ROUNDS / 10; i++) {
+    Environment *env = environment_create(globals);
+    Value value = value_create_int(i);
+    environment_define_default(env, a, &value, int_type);
+    environment_define_default(env, b, &value, int_type);
+    checksum += environment_get(env, b)->int_val;
+    environment_destroy(env);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  printf("heap scope, 2 names  %6.2f ns/op  (checksum %lld)\n",
+         elapsed_ns(start, end) / (ROUNDS / 10), checksum);
+  environment_destroy(globals);
+}
+
+int main(void) {
+  size_t lengths[] = {8, 40, 200};
+
+  printf("Object churn, %d strings per row\n", ROUNDS);
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    bench_strings(lengths[i]);
+  }
+  bench_scopes();
+  return 0;
+}
@@ -0,0 +1,170 @@
+// Parses generated scripts of 1k to 1M top-level statements and checks that
+// parse time and tree memory per statement stay flat as the script grows,
+// i.e. that no list in the parser is quadratic or capped. Each script is
+// then compiled and run on the VM, as the interpreter does by default, so
+// that no pool in the compiler or VM is quadratic or capped either. The
+// arena only holds the tree, so memory is also checked as the growth of the
+// process's peak resident set, which covers the symbol and source file
+// tables, the lexer's line table, the chunks and the environments.
+
+#include "interpreter.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define SMALLEST 1000
+#define LARGEST 1000000
+// Time per statement may rise somewhat once the tree outgrows the caches;
+// anything past this factor means something grows faster than linearly.
+#define MAX_TIME_GROWTH 4.0
+#define MAX_MEMORY_GROWTH 1.25
+
+// Peak resident set of the process so far. It never shrinks, but sizes are
+// measured smallest first and each is ten times the last, so the growth over
+// the peak at startup is close to what the current size needed.
+static size_t peak_rss(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss;
+#else
+  return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static double elapsed_s(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Cycles through small functions, declarations, calls and format strings,
+// each using only names declared before it so that the script also runs.
+// Every name is distinct, so the program's pools grow with the script.
+static char *generate(int statements, size_t *length) {
+  size_t capacity = (size_t)statements * 96 + 1024;
+  char *source = malloc(capacity);
+  size_t used = 0;
+
+  for (int i = 0; i < statements; i++) {
+    switch (i % 4) {
+    case 0:
+      used += (size_t)snprintf(source + used, capacity - used,
+                               "fnc f%d(int a, b = 2) -> int {\n  return a * b\n}\n", i);
+      break;
+    case 1:
+      used += (size_t)snprintf(source + used, capacity - used,
+                               "let int: v%d = %d * 3 + 1\n", i, i);
+      break;
+    case 2:
+      used += (size_t)snprintf(source + used, capacity - used,
+                               "let r%d = f%d(v%d, %d)\n", i, i - 2, i - 1, i);
+      break;
+    default:
+      used += (size_t)snprintf(source + used, capacity - used,
+                               "let s%d = \"total ${v%d + %d}\"\n", i, i - 2, i);
+      break;
+    }
+  }
+
+  *length = used;
+  return source;
+}
+
+typedef struct {
+  double seconds_per_statement;
+  double bytes_per_statement;
+  double run_seconds_per_statement;
+  double peak_bytes_per_statement;
+} Cost;
+
+// Compiles and runs the program on the VM. The last statement declares
+// s<statements - 1>, which is bound only if every chunk ran.
+static double run(ASTNode *program, Arena *arena, int statements) {
+  optimizer_run(program, arena, true);
+  resolver_resolve(program);
+  Interpreter *interpreter = interpreter_create();
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  interpreter_run(interpreter, program);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  char last[32];
+  snprintf(last, sizeof(last), "s%d", statements - 1);
+  if (!environment_get(interpreter->global_env, symbol_intern(last))) {
+    fprintf(stderr, "program of %d statements did not run to the end\n",
+            statements);
+    exit(1);
+  }
+  interpreter_destroy(interpreter);
+  return elapsed_s(start, end);
+}
+
+static Cost measure(int statements, size_t startup_peak) {
+  size_t length;
+  char *source = generate(statements, &length);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  Lexer *lexer = lexer_create(source, length, "bench.lz");
+  Arena *arena = arena_create();
+  Parser *parser = parser_create(lexer, arena);
+  ASTNode *program = parser_parse(parser);
+  parser_destroy(parser);
+  lexer_destroy(lexer);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (!program || program->program.statement_count != statements) {
+    fprintf(stderr, "parsed %d of %d statements\n",
+            program ? program->program.statement_count : 0, statements);
+    exit(1);
+  }
+
+  double seconds = elapsed_s(start, end);
+  size_t bytes = arena_size(arena);
+  double run_seconds = run(program, arena, statements);
+  size_t peak = peak_rss() - startup_peak;
+  printf("%8d statements  %8.2f ms  %7.1f ns/stmt  %7.1f MB  %6.1f B/stmt"
+         "  run %8.2f ms  %7.1f ns/stmt  peak %7.1f MB  %6.1f B/stmt\n",
+         statements, seconds * 1e3, seconds * 1e9 / statements,
+         bytes / (1024.0 * 1024.0), (double)bytes / statements,
+         run_seconds * 1e3, run_seconds * 1e9 / statements,
+         peak / (1024.0 * 1024.0), (double)peak / statements);
+
+  arena_destroy(arena);
+  free(source);
+
+  Cost cost = {seconds / statements, (double)bytes / statements,
+               run_seconds / statements, (double)peak / statements};
+  return cost;
+}
+
+int main(void) {
+  printf("Parser scaling\n");
+  size_t startup_peak = peak_rss();
+  Cost first = {0, 0, 0, 0}, last = {0, 0, 0, 0};
+  for (int statements = SMALLEST; statements <= LARGEST; statements *= 10) {
+    last = measure(statements, startup_peak);
+    if (statements == SMALLEST)
+      first = last;
+  }
+
+  double time_growth = last.seconds_per_statement / first.seconds_per_statement;
+  double memory_growth = last.bytes_per_statement / first.bytes_per_statement;
+  double run_growth =
+      last.run_seconds_per_statement / first.run_seconds_per_statement;
+  double peak_growth =
+      last.peak_bytes_per_statement / first.peak_bytes_per_statement;
+  printf("per-statement growth from %d to %d: time x%.2f, memory x%.2f, "
+         "run x%.2f, peak x%.2f\n", SMALLEST, LARGEST, time_growth,
+         memory_growth, run_growth, peak_growth);
+
+  if (time_growth > MAX_TIME_GROWTH || memory_growth > MAX_MEMORY_GROWTH ||
+      run_growth > MAX_TIME_GROWTH || peak_growth > MAX_MEMORY_GROWTH) {
+    printf("not linear\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN(size) (((size) + 15) & ~(size_t)15)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t size;
+};
+
+struct ArenaCleanup {
+    ArenaCleanup *next;
+    void (*cleanup)(void *data);
+    void *data;
+};
+
+static char *arena_block_data(ArenaBlock *block) {
+    return (char *)block + ARENA_ALIGN(sizeof(ArenaBlock));
+}
+
+static ArenaBlock *arena_block_create(size_t size) {
+    ArenaBlock *block = malloc(ARENA_ALIGN(sizeof(ArenaBlock)) + size);
+    if (!block) return NULL;
+
+    block->next = NULL;
+    block->used = 0;
+    block->size = size;
+    return block;
+}
+
+Arena *arena_create(void) {
+    Arena *arena = malloc(sizeof(Arena));
+    if (!arena) return NULL;
+
+    arena->head = arena_block_create(ARENA_BLOCK_SIZE);
+    arena->cleanups = NULL;
+    if (!arena->head) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) return;
+
+    for (ArenaCleanup *entry = arena->cleanups; entry; entry = entry->next)
+        entry->cleanup(entry->data);
+
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = ARENA_ALIGN(size ? size : 1);
+
+    ArenaBlock *head = arena->head;
+    if (head->size - head->used >= size) {
+        void *memory = arena_block_data(head) + head->used;
+        head->used += size;
+        return memory;
+    }
+
+    // Large requests get a block of their own behind the head, so the
+    // space left in the head is not abandoned.
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        ArenaBlock *block = arena_block_create(size);
+        if (!block) return NULL;
+
+        block->used = size;
+        block->next = head->next;
+        head->next = block;
+        return arena_block_data(block);
+    }
+
+    ArenaBlock *block = arena_block_create(ARENA_BLOCK_SIZE);
+    if (!block) return NULL;
+
+    block->used = size;
+    block->next = head;
+    arena->head = block;
+    return arena_block_data(block);
+}
+
+char *arena_strndup(Arena *arena, const char *text, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *text) {
+    return arena_strndup(arena, text, strlen(text));
+}
+
+bool arena_add_cleanup(Arena *arena, void (*cleanup)(void *data), void *data) {
+    ArenaCleanup *entry = arena_alloc(arena, sizeof(ArenaCleanup));
+    if (!entry) return false;
+
+    entry->cleanup = cleanup;
+    entry->data = data;
+    entry->next = arena->cleanups;
+    arena->cleanups = entry;
+    return true;
+}
+
+size_t arena_size(const Arena *arena) {
+    size_t size = 0;
+    for (ArenaBlock *block = arena->head; block; block = block->next)
+        size += ARENA_ALIGN(sizeof(ArenaBlock)) + block->size;
+    return size;
+}
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct ArenaCleanup ArenaCleanup;
+
+// Bump allocator for data that lives and dies together, such as the AST of
+// one compilation unit. Allocations are never freed one by one; the whole
+// arena goes at once, so tearing down a tree costs one free per 64KB block
+// instead of one per node.
+typedef struct Arena {
+    ArenaBlock *head;       // Block being carved; older blocks follow
+    ArenaCleanup *cleanups; // Run by arena_destroy, newest first
+} Arena;
+
+Arena *arena_create(void);
+void arena_destroy(Arena *arena);
+
+// Memory is aligned for any scalar or pointer and is not zeroed.
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *text, size_t length);
+char *arena_strdup(Arena *arena, const char *text);
+
+// Calls `cleanup(data)` when the arena is destroyed, for heap objects the
+// tree owns, such as the Strings of its literals. Returns false if the
+// record could not be allocated, in which case nothing will be called.
+bool arena_add_cleanup(Arena *arena, void (*cleanup)(void *data), void *data);
+
+// Bytes held in blocks, used or not.
+size_t arena_size(const Arena *arena);
+
+#endif
@@ -0,0 +1,345 @@
+#include "bytecode.h"
+#include <stdlib.h>
+#include <string.h>
+
+Chunk *chunk_create(void) {
+  Chunk *chunk = malloc(sizeof(Chunk));
+  if (!chunk)
+    return NULL;
+
+  memset(chunk, 0, sizeof(Chunk));
+  return chunk;
+}
+
+void chunk_destroy(Chunk *chunk) {
+  if (!chunk)
+    return;
+
+  for (int i = 0; i < chunk->constant_count; i++) {
+    value_destroy(chunk->constants[i]);
+  }
+  for (int i = 0; i < chunk->function_count; i++) {
+    chunk_destroy(chunk->functions[i].chunk);
+  }
+
+  free(chunk->code);
+  free(chunk->position_of);
+  free(chunk->positions);
+  free(chunk->constants);
+  free(chunk->constant_index.slots);
+  free(chunk->names);
+  free(chunk->name_index.slots);
+  free(chunk->types);
+  free(chunk->functions);
+  free(chunk->formats);
+  free(chunk->call_caches);
+  free(chunk->regions);
+  free(chunk);
+}
+
+static int chunk_add_position(Chunk *chunk, Position pos) {
+  if (chunk->position_count > 0) {
+    Position *last = &chunk->positions[chunk->position_count - 1];
+    if (last->offset == pos.offset && last->file == pos.file) {
+      return chunk->position_count - 1;
+    }
+  }
+
+  if (chunk->position_count >= chunk->position_capacity) {
+    chunk->position_capacity =
+        chunk->position_capacity ? chunk->position_capacity * 2 : 16;
+    chunk->positions = realloc(chunk->positions,
+                               sizeof(Position) * chunk->position_capacity);
+  }
+
+  chunk->positions[chunk->position_count] = pos;
+  return chunk->position_count++;
+}
+
+void chunk_write(Chunk *chunk, uint8_t byte, Position pos) {
+  if (chunk->count >= chunk->capacity) {
+    chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+    chunk->code = realloc(chunk->code, chunk->capacity);
+    chunk->position_of = realloc(chunk->position_of,
+                                 sizeof(int) * chunk->capacity);
+  }
+
+  chunk->code[chunk->count] = byte;
+  chunk->position_of[chunk->count] = chunk_add_position(chunk, pos);
+  chunk->count++;
+}
+
+void chunk_write_short(Chunk *chunk, uint16_t value, Position pos) {
+  chunk_write(chunk, (uint8_t)(value & 0xFF), pos);
+  chunk_write(chunk, (uint8_t)(value >> 8), pos);
+}
+
+void chunk_patch_short(Chunk *chunk, int offset, uint16_t value) {
+  chunk->code[offset] = (uint8_t)(value & 0xFF);
+  chunk->code[offset + 1] = (uint8_t)(value >> 8);
+}
+
+typedef uint32_t (*PoolHash)(const Chunk *chunk, int entry);
+
+// Makes room for one more entry, rehashing the first `entries`.
+static void pool_index_reserve(const Chunk *chunk, PoolIndex *index,
+                               int entries, PoolHash hash) {
+  if ((entries + 1) * 2 <= index->capacity)
+    return;
+
+  int capacity = index->capacity ? index->capacity * 2 : 16;
+  free(index->slots);
+  index->slots = calloc((size_t)capacity, sizeof(int));
+  index->capacity = capacity;
+
+  for (int i = 0; i < entries; i++) {
+    uint32_t mask = (uint32_t)capacity - 1;
+    uint32_t slot = hash(chunk, i) & mask;
+    while (index->slots[slot]) {
+      slot = (slot + 1) & mask;
+    }
+    index->slots[slot] = i + 1;
+  }
+}
+
+static uint32_t constant_hash(const Chunk *chunk, int entry) {
+  Value value = chunk->constants[entry];
+
+  switch (value.type) {
+  case VALUE_INT:
+    return (uint32_t)value.int_val * 2654435761u;
+  case VALUE_FLOAT: {
+    uint64_t bits;
+    memcpy(&bits, &value.float_val, sizeof(bits));
+    return (uint32_t)(bits ^ (bits >> 32)) * 2654435761u;
+  }
+  case VALUE_STRING:
+    return string_hash(value.string_val);
+  case VALUE_BOOL:
+    return value.bool_val ? 3 : 2;
+  default:
+    return (uint32_t)value.type;
+  }
+}
+
+// Floats compare by bit pattern, so 0.0 and -0.0 stay apart.
+static bool constant_equal(Value a, Value b) {
+  if (a.type != b.type)
+    return false;
+
+  switch (a.type) {
+  case VALUE_INT:
+    return a.int_val == b.int_val;
+  case VALUE_FLOAT:
+    return memcmp(&a.float_val, &b.float_val, sizeof(double)) == 0;
+  case VALUE_STRING:
+    return a.string_val->length == b.string_val->length &&
+           memcmp(a.string_val->chars, b.string_val->chars,
+                  a.string_val->length) == 0;
+  case VALUE_BOOL:
+    return a.bool_val == b.bool_val;
+  case VALUE_NULL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+int chunk_add_constant(Chunk *chunk, Value value) {
+  if (chunk->constant_count >= chunk->constant_capacity) {
+    chunk->constant_capacity =
+        chunk->constant_capacity ? chunk->constant_capacity * 2 : 8;
+    chunk->constants = realloc(chunk->constants,
+                               sizeof(Value) * chunk->constant_capacity);
+  }
+
+  // Staged past the end of the pool so it can be hashed like the others.
+  chunk->constants[chunk->constant_count] = value;
+  pool_index_reserve(chunk, &chunk->constant_index, chunk->constant_count,
+                     constant_hash);
+
+  PoolIndex *index = &chunk->constant_index;
+  uint32_t mask = (uint32_t)index->capacity - 1;
+  uint32_t slot = constant_hash(chunk, chunk->constant_count) & mask;
+  while (index->slots[slot]) {
+    int entry = index->slots[slot] - 1;
+    if (constant_equal(chunk->constants[entry], value)) {
+      value_destroy(value);
+      return entry;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  index->slots[slot] = chunk->constant_count + 1;
+  return chunk->constant_count++;
+}
+
+static uint32_t name_hash(const Chunk *chunk, int entry) {
+  return chunk->names[entry]->hash;
+}
+
+int chunk_add_name(Chunk *chunk, Symbol *name) {
+  pool_index_reserve(chunk, &chunk->name_index, chunk->name_count, name_hash);
+
+  PoolIndex *index = &chunk->name_index;
+  uint32_t mask = (uint32_t)index->capacity - 1;
+  uint32_t slot = name->hash & mask;
+  while (index->slots[slot]) {
+    int entry = index->slots[slot] - 1;
+    if (chunk->names[entry] == name) {
+      return entry;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  if (chunk->name_count >= chunk->name_capacity) {
+    chunk->name_capacity = chunk->name_capacity ? chunk->name_capacity * 2 : 8;
+    chunk->names = realloc(chunk->names, sizeof(Symbol *) * chunk->name_capacity);
+  }
+
+  chunk->names[chunk->name_count] = name;
+  index->slots[slot] = chunk->name_count + 1;
+  return chunk->name_count++;
+}
+
+int chunk_add_type(Chunk *chunk, const Type *type) {
+  for (int i = 0; i < chunk->type_count; i++) {
+    if (chunk->types[i] == type) {
+      return i;
+    }
+  }
+
+  if (chunk->type_count >= chunk->type_capacity) {
+    chunk->type_capacity = chunk->type_capacity ? chunk->type_capacity * 2 : 4;
+    chunk->types = realloc(chunk->types, sizeof(Type *) * chunk->type_capacity);
+  }
+
+  chunk->types[chunk->type_count] = type;
+  return chunk->type_count++;
+}
+
+int chunk_add_function(Chunk *chunk, struct ASTNode *declaration, Chunk *body) {
+  if (chunk->function_count >= chunk->function_capacity) {
+    chunk->function_capacity =
+        chunk->function_capacity ? chunk->function_capacity * 2 : 4;
+    chunk->functions = realloc(chunk->functions,
+                               sizeof(FunctionProto) * chunk->function_capacity);
+  }
+
+  chunk->functions[chunk->function_count].declaration = declaration;
+  chunk->functions[chunk->function_count].chunk = body;
+  return chunk->function_count++;
+}
+
+int chunk_add_format(Chunk *chunk, const struct FormatTemplate *format) {
+  if (chunk->format_count >= chunk->format_capacity) {
+    chunk->format_capacity = chunk->format_capacity ? chunk->format_capacity * 2 : 8;
+    chunk->formats = realloc(chunk->formats,
+                             sizeof(*chunk->formats) * chunk->format_capacity);
+  }
+
+  chunk->formats[chunk->format_count] = format;
+  return chunk->format_count++;
+}
+
+int chunk_add_call_cache(Chunk *chunk) {
+  if (chunk->call_cache_count >= chunk->call_cache_capacity) {
+    chunk->call_cache_capacity =
+        chunk->call_cache_capacity ? chunk->call_cache_capacity * 2 : 8;
+    chunk->call_caches = realloc(chunk->call_caches,
+                                 sizeof(CallCache) * chunk->call_cache_capacity);
+  }
+
+  memset(&chunk->call_caches[chunk->call_cache_count], 0, sizeof(CallCache));
+  return chunk->call_cache_count++;
+}
+
+int chunk_add_region(Chunk *chunk, RecoveryRegion region) {
+  if (chunk->region_count >= chunk->region_capacity) {
+    chunk->region_capacity =
+        chunk->region_capacity ? chunk->region_capacity * 2 : 8;
+    chunk->regions = realloc(chunk->regions,
+                             sizeof(RecoveryRegion) * chunk->region_capacity);
+  }
+
+  chunk->regions[chunk->region_count] = region;
+  return chunk->region_count++;
+}
+
+Position chunk_position_at(Chunk *chunk, int offset) {
+  if (offset < 0 || offset >= chunk->count) {
+    return POSITION_NONE;
+  }
+  return chunk->positions[chunk->position_of[offset]];
+}
+
+// Only consulted after a runtime error, so a linear scan is fine. `offset`
+// is the instruction pointer after the failing instruction was decoded.
+RecoveryRegion *chunk_find_region(Chunk *chunk, int offset) {
+  RecoveryRegion *best = NULL;
+
+  for (int i = 0; i < chunk->region_count; i++) {
+    RecoveryRegion *region = &chunk->regions[i];
+    if (offset <= region->start || offset > region->end)
+      continue;
+
+    if (!best || region->start > best->start ||
+        (region->start == best->start && region->end < best->end)) {
+      best = region;
+    }
+  }
+
+  return best;
+}
+
+const char *opcode_name(OpCode op) {
+  static const char *const names[OP_COUNT] = {
+    [OP_CONSTANT] = "CONSTANT",
+    [OP_CONSTANT_LONG] = "CONSTANT_LONG",
+    [OP_NULL] = "NULL",
+    [OP_POP] = "POP",
+    [OP_GET_NAME] = "GET_NAME",
+    [OP_GET_LOCAL] = "GET_LOCAL",
+    [OP_SET_NAME] = "SET_NAME",
+    [OP_SET_LOCAL] = "SET_LOCAL",
+    [OP_DEFINE_NAME] = "DEFINE_NAME",
+    [OP_ADD] = "ADD",
+    [OP_SUBTRACT] = "SUBTRACT",
+    [OP_MULTIPLY] = "MULTIPLY",
+    [OP_DIVIDE] = "DIVIDE",
+    [OP_MODULO] = "MODULO",
+    [OP_INT_DIVIDE] = "INT_DIVIDE",
+    [OP_NEGATE] = "NEGATE",
+    [OP_UNARY] = "UNARY",
+    [OP_FORMAT] = "FORMAT",
+    [OP_PRINT] = "PRINT",
+    [OP_PRINTLN] = "PRINTLN",
+    [OP_LOOKUP_CALLEE] = "LOOKUP_CALLEE",
+    [OP_LOOKUP_LOCAL_CALLEE] = "LOOKUP_LOCAL_CALLEE",
+    [OP_CHECK_ARG] = "CHECK_ARG",
+    [OP_CALL] = "CALL",
+    [OP_DEFAULT_ARG] = "DEFAULT_ARG",
+    [OP_CHECK_PARAM] = "CHECK_PARAM",
+    [OP_ENTER] = "ENTER",
+    [OP_PUSH_SCOPE] = "PUSH_SCOPE",
+    [OP_POP_SCOPE] = "POP_SCOPE",
+    [OP_SCOPE_ELIDED] = "SCOPE_ELIDED",
+    [OP_DEFINE_FUNCTION] = "DEFINE_FUNCTION",
+    [OP_RETURN] = "RETURN",
+    [OP_RETURN_NOTHING] = "RETURN_NOTHING",
+    [OP_HALT] = "HALT",
+    [OP_ADD_INT] = "ADD_INT",
+    [OP_SUBTRACT_INT] = "SUBTRACT_INT",
+    [OP_MULTIPLY_INT] = "MULTIPLY_INT",
+    [OP_MODULO_INT] = "MODULO_INT",
+    [OP_INT_DIVIDE_INT] = "INT_DIVIDE_INT",
+    [OP_ADD_FLOAT] = "ADD_FLOAT",
+    [OP_SUBTRACT_FLOAT] = "SUBTRACT_FLOAT",
+    [OP_MULTIPLY_FLOAT] = "MULTIPLY_FLOAT",
+    [OP_DIVIDE_FLOAT] = "DIVIDE_FLOAT",
+    [OP_GET_LOCAL_FAST] = "GET_LOCAL_FAST",
+    [OP_GET_LOCAL_PAIR] = "GET_LOCAL_PAIR",
+    [OP_GET_LOCAL_CONSTANT] = "GET_LOCAL_CONSTANT",
+  };
+  return op < OP_COUNT && names[op] ? names[op] : "UNKNOWN";
+}
@@ -0,0 +1,172 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include "lexer.h"
+#include "value.h"
+#include "environment.h"
+
+// Operands are encoded inline after the opcode; u16 operands are little endian.
+//
+// The VM quickens code in place as it runs. An arithmetic instruction whose
+// operands are both int (or both float) is rewritten into the specialized
+// form for those types, and a local load whose slot is bound is rewritten
+// into a form that reads the slot directly, fused with a local or constant
+// load that follows it. Quickened forms keep the layout of the instruction
+// they replace, so positions, recovery regions and jumps stay valid; a
+// fused form leaves the instruction it absorbs intact, to be run on its own
+// if control ever lands on it. When a guard fails the instruction goes
+// back to its generic form; an arithmetic site that does so is marked in
+// its operand and never quickened again.
+typedef enum {
+  OP_CONSTANT,        // u16 constant index
+  OP_CONSTANT_LONG,   // u16 low half, u16 high half of a constant index
+  OP_NULL,
+  OP_POP,
+  OP_GET_NAME,        // u16 name index
+  OP_GET_LOCAL,       // u16 name index, u8 depth, u16 slot
+  OP_SET_NAME,        // u16 name index
+  OP_SET_LOCAL,       // u16 name index, u8 depth, u16 slot
+  OP_DEFINE_NAME,     // u16 name index, u16 slot, u16 type index, u8 flags
+  OP_ADD,             // u8 deoptimized flag, as for every arithmetic opcode
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_MODULO,
+  OP_INT_DIVIDE,
+  OP_NEGATE,
+  OP_UNARY,           // u8 operator token
+  OP_FORMAT,          // u16 format index, u16 expression count
+  OP_PRINT,
+  OP_PRINTLN,
+  OP_LOOKUP_CALLEE,   // u16 name index, u16 argument count, u16 call cache index
+  OP_LOOKUP_LOCAL_CALLEE, // u16 name index, u8 depth, u16 slot, u16 argument count,
+                          // u16 call cache index
+  OP_CHECK_ARG,       // u16 parameter index
+  OP_CALL,            // u16 argument count
+  OP_DEFAULT_ARG,     // u16 parameter index, u16 jump past the default
+  OP_CHECK_PARAM,     // u16 parameter index
+  OP_ENTER,
+  OP_PUSH_SCOPE,      // u16 slot count
+  OP_POP_SCOPE,
+  OP_SCOPE_ELIDED,    // Only emitted with stats on; counts a block run in place
+  OP_DEFINE_FUNCTION, // u16 function prototype index, u16 slot
+  OP_RETURN,
+  OP_RETURN_NOTHING,
+  OP_HALT,
+
+  // Quickened forms, only ever written by the VM.
+  OP_ADD_INT,
+  OP_SUBTRACT_INT,
+  OP_MULTIPLY_INT,
+  OP_MODULO_INT,
+  OP_INT_DIVIDE_INT,
+  OP_ADD_FLOAT,
+  OP_SUBTRACT_FLOAT,
+  OP_MULTIPLY_FLOAT,
+  OP_DIVIDE_FLOAT,
+  OP_GET_LOCAL_FAST,      // Operands of OP_GET_LOCAL
+  OP_GET_LOCAL_PAIR,      // Also runs the OP_GET_LOCAL after it
+  OP_GET_LOCAL_CONSTANT,  // Also runs the OP_CONSTANT after it
+  OP_COUNT
+} OpCode;
+
+#define DEFINE_HAS_VALUE 0x01
+#define DEFINE_FIXED 0x02
+#define NO_OPERAND 0xFFFF   // Also marks a define in a dynamic scope (no slot)
+
+typedef enum {
+  RECOVER_STATEMENT,
+  RECOVER_FORMAT
+} RecoveryKind;
+
+// A runtime error inside [start, end) unwinds the operand stack to
+// stack_depth and resumes at end, the same way the tree walker abandons the
+// innermost statement. Format placeholders leave an empty marker instead.
+typedef struct {
+  int start;
+  int end;
+  int stack_depth;
+  int callee_depth;
+  RecoveryKind kind;
+  int index;
+} RecoveryRegion;
+
+struct Chunk;
+struct FormatTemplate;
+
+// Hash index over one of a chunk's pools, so that adding an entry the pool
+// already holds finds it without a scan.
+typedef struct {
+  int *slots;             // Entry index + 1, or 0 if empty
+  int capacity;           // Power of two, kept at most half full
+} PoolIndex;
+
+typedef struct {
+  struct ASTNode *declaration;
+  struct Chunk *chunk;
+} FunctionProto;
+
+typedef struct Chunk {
+  uint8_t *code;
+  int *position_of;       // Index into positions for every code byte
+  int count;
+  int capacity;
+
+  Position *positions;
+  int position_count;
+  int position_capacity;
+
+  Value *constants;       // Each distinct literal once
+  int constant_count;
+  int constant_capacity;
+  PoolIndex constant_index;
+
+  Symbol **names;         // Variable and function names
+  int name_count;
+  int name_capacity;
+  PoolIndex name_index;
+
+  const Type **types;     // Declared variable types
+  int type_count;
+  int type_capacity;
+
+  FunctionProto *functions;
+  int function_count;
+  int function_capacity;
+
+  const struct FormatTemplate **formats; // Owned by the AST, like declarations
+  int format_count;
+  int format_capacity;
+
+  CallCache *call_caches; // One per callee lookup instruction
+  int call_cache_count;
+  int call_cache_capacity;
+
+  RecoveryRegion *regions;
+  int region_count;
+  int region_capacity;
+
+  int max_stack;          // Deepest operand stack use, including arguments
+  int max_callees;        // Deepest nesting of calls awaiting arguments
+} Chunk;
+
+Chunk *chunk_create(void);
+void chunk_destroy(Chunk *chunk);
+void chunk_write(Chunk *chunk, uint8_t byte, Position pos);
+void chunk_write_short(Chunk *chunk, uint16_t value, Position pos);
+void chunk_patch_short(Chunk *chunk, int offset, uint16_t value);
+// Takes ownership of `value`; an equal constant already in the pool is
+// reused and `value` released.
+int chunk_add_constant(Chunk *chunk, Value value);
+int chunk_add_name(Chunk *chunk, Symbol *name);
+int chunk_add_type(Chunk *chunk, const Type *type);
+int chunk_add_function(Chunk *chunk, struct ASTNode *declaration, Chunk *body);
+int chunk_add_format(Chunk *chunk, const struct FormatTemplate *format);
+int chunk_add_call_cache(Chunk *chunk);
+int chunk_add_region(Chunk *chunk, RecoveryRegion region);
+Position chunk_position_at(Chunk *chunk, int offset);
+const char *opcode_name(OpCode op);
+RecoveryRegion *chunk_find_region(Chunk *chunk, int offset);
+
+#endif
@@ -0,0 +1,403 @@
+#include "compiler.h"
+#include "error.h"
+
+typedef struct {
+  Chunk *chunk;
+  int depth;       // Operand stack depth at the current instruction
+  int callees;     // Calls whose callee is resolved but not yet invoked
+  bool count_scopes;
+  bool had_error;
+} Compiler;
+
+static void compile_statement(Compiler *compiler, ASTNode *node);
+static void compile_expression(Compiler *compiler, ASTNode *node);
+
+static void compiler_error(Compiler *compiler, Position pos, const char *message) {
+  if (!compiler->had_error) {
+    error_report(ERROR_PARSER, pos, message,
+                 "Simplify the program or run it with --tree-walk");
+  }
+  compiler->had_error = true;
+}
+
+static void adjust_depth(Compiler *compiler, int delta) {
+  compiler->depth += delta;
+  if (compiler->depth > compiler->chunk->max_stack) {
+    compiler->chunk->max_stack = compiler->depth;
+  }
+}
+
+static void adjust_callees(Compiler *compiler, int delta) {
+  compiler->callees += delta;
+  if (compiler->callees > compiler->chunk->max_callees) {
+    compiler->chunk->max_callees = compiler->callees;
+  }
+}
+
+static void emit_byte(Compiler *compiler, uint8_t byte, Position pos) {
+  chunk_write(compiler->chunk, byte, pos);
+}
+
+static void emit_short(Compiler *compiler, int value, Position pos) {
+  if (value < 0 || value >= NO_OPERAND) {
+    compiler_error(compiler, pos, "Too many names or constants in one scope");
+    value = 0;
+  }
+  chunk_write_short(compiler->chunk, (uint16_t)value, pos);
+}
+
+// Pools past the reach of a u16 operand still load through the long form.
+static void emit_constant(Compiler *compiler, Value value, Position pos) {
+  int index = chunk_add_constant(compiler->chunk, value);
+  if (index < NO_OPERAND) {
+    emit_byte(compiler, OP_CONSTANT, pos);
+    emit_short(compiler, index, pos);
+  } else {
+    emit_byte(compiler, OP_CONSTANT_LONG, pos);
+    chunk_write_short(compiler->chunk, (uint16_t)(index & 0xFFFF), pos);
+    chunk_write_short(compiler->chunk, (uint16_t)(index >> 16), pos);
+  }
+}
+
+static void emit_count(Compiler *compiler, int count, Position pos) {
+  if (count < 0 || count > UINT16_MAX) {
+    compiler_error(compiler, pos, "Too many arguments or placeholders");
+    count = 0;
+  }
+  chunk_write_short(compiler->chunk, (uint16_t)count, pos);
+}
+
+static int begin_region(Compiler *compiler, RecoveryKind kind, int index) {
+  RecoveryRegion region = {
+    .start = compiler->chunk->count,
+    .end = compiler->chunk->count,
+    .stack_depth = compiler->depth,
+    .callee_depth = compiler->callees,
+    .kind = kind,
+    .index = index
+  };
+  return chunk_add_region(compiler->chunk, region);
+}
+
+static void end_region(Compiler *compiler, int region) {
+  compiler->chunk->regions[region].end = compiler->chunk->count;
+}
+
+// Emits `local_op` when the resolver pinned the name to a slot the operands
+// can encode, and the by-name `dynamic_op` otherwise. Both take the name
+// first, so the VM can fall back to a lookup by name.
+static void emit_name(Compiler *compiler, OpCode dynamic_op, OpCode local_op,
+                      Symbol *name, EnvSlot where, Position pos) {
+  bool local = where.depth >= 0 && where.depth <= UINT8_MAX &&
+               where.slot < NO_OPERAND;
+
+  emit_byte(compiler, local ? local_op : dynamic_op, pos);
+  emit_short(compiler, chunk_add_name(compiler->chunk, name), pos);
+  if (local) {
+    emit_byte(compiler, (uint8_t)where.depth, pos);
+    chunk_write_short(compiler->chunk, (uint16_t)where.slot, pos);
+  }
+}
+
+static void emit_slot(Compiler *compiler, int slot, Position pos) {
+  chunk_write_short(compiler->chunk,
+                    slot >= 0 && slot < NO_OPERAND ? (uint16_t)slot : NO_OPERAND,
+                    pos);
+}
+
+static OpCode binary_opcode(TokenType operator) {
+  switch (operator) {
+  case TOKEN_PLUS:
+    return OP_ADD;
+  case TOKEN_MINUS:
+    return OP_SUBTRACT;
+  case TOKEN_MULTIPLY:
+    return OP_MULTIPLY;
+  case TOKEN_DIVIDE:
+    return OP_DIVIDE;
+  case TOKEN_MODULO:
+    return OP_MODULO;
+  case TOKEN_INT_DIVIDE:
+    return OP_INT_DIVIDE;
+  default:
+    return OP_HALT;
+  }
+}
+
+static void compile_call(Compiler *compiler, ASTNode *node) {
+  int argc = node->function_call.argument_count;
+
+  emit_name(compiler, OP_LOOKUP_CALLEE, OP_LOOKUP_LOCAL_CALLEE,
+            node->function_call.name, node->function_call.where, node->pos);
+  emit_count(compiler, argc, node->pos);
+  emit_short(compiler, chunk_add_call_cache(compiler->chunk), node->pos);
+  adjust_callees(compiler, 1);
+
+  // Arguments are type-checked as soon as each one is produced, matching the
+  // order in which the tree walker evaluates and binds them.
+  for (int i = 0; i < argc; i++) {
+    compile_expression(compiler, node->function_call.arguments[i]);
+    emit_byte(compiler, OP_CHECK_ARG, node->pos);
+    emit_count(compiler, i, node->pos);
+  }
+
+  emit_byte(compiler, OP_CALL, node->pos);
+  emit_count(compiler, argc, node->pos);
+  adjust_callees(compiler, -1);
+  adjust_depth(compiler, 1 - argc);
+}
+
+static void compile_format_string(Compiler *compiler, ASTNode *node) {
+  int count = node->format_string.expression_count;
+
+  for (int i = 0; i < count; i++) {
+    int region = begin_region(compiler, RECOVER_FORMAT, i);
+    compile_expression(compiler, node->format_string.expressions[i]);
+    end_region(compiler, region);
+  }
+
+  emit_byte(compiler, OP_FORMAT, node->pos);
+  emit_short(compiler,
+             chunk_add_format(compiler->chunk, &node->format_string.segments),
+             node->pos);
+  emit_count(compiler, count, node->pos);
+  adjust_depth(compiler, 1 - count);
+}
+
+static void compile_expression(Compiler *compiler, ASTNode *node) {
+  switch (node->type) {
+  case AST_LITERAL:
+    emit_constant(compiler, value_copy(node->literal.value), node->pos);
+    adjust_depth(compiler, 1);
+    break;
+
+  case AST_IDENTIFIER:
+    emit_name(compiler, OP_GET_NAME, OP_GET_LOCAL, node->identifier.name,
+              node->identifier.where, node->pos);
+    adjust_depth(compiler, 1);
+    break;
+
+  case AST_BINARY_EXPRESSION: {
+    OpCode op = binary_opcode(node->binary_expression.operator);
+    if (op == OP_HALT) {
+      compiler_error(compiler, node->pos, "Unsupported binary operator");
+      return;
+    }
+    compile_expression(compiler, node->binary_expression.left);
+    compile_expression(compiler, node->binary_expression.right);
+    emit_byte(compiler, op, node->pos);
+    emit_byte(compiler, 0, node->pos);
+    adjust_depth(compiler, -1);
+    break;
+  }
+
+  case AST_UNARY_EXPRESSION:
+    compile_expression(compiler, node->unary_expression.operand);
+    if (node->unary_expression.operator == TOKEN_MINUS) {
+      emit_byte(compiler, OP_NEGATE, node->pos);
+    } else {
+      emit_byte(compiler, OP_UNARY, node->pos);
+      emit_byte(compiler, (uint8_t)node->unary_expression.operator, node->pos);
+    }
+    break;
+
+  case AST_FUNCTION_CALL:
+    compile_call(compiler, node);
+    break;
+
+  case AST_FORMAT_STRING:
+    compile_format_string(compiler, node);
+    break;
+
+  default:
+    compiler_error(compiler, node->pos, "Statement used where a value is expected");
+    break;
+  }
+}
+
+static Chunk *compile_function(ASTNode *node, bool count_scopes,
+                               bool *had_error) {
+  Compiler compiler = {chunk_create(), 0, 0, count_scopes, false};
+  int param_count = node->function_declaration.param_count;
+
+  // Missing arguments are filled in by the callee, still in the caller's
+  // scope, before OP_ENTER binds every parameter in a fresh environment.
+  for (int i = 0; i < param_count; i++) {
+    if (!node->function_declaration.param_has_default[i])
+      continue;
+
+    compiler.depth = i;
+    emit_byte(&compiler, OP_DEFAULT_ARG, node->pos);
+    emit_count(&compiler, i, node->pos);
+    int jump = compiler.chunk->count;
+    emit_short(&compiler, 0, node->pos);
+
+    compile_expression(&compiler, node->function_declaration.param_defaults[i]);
+    emit_byte(&compiler, OP_CHECK_PARAM, node->pos);
+    emit_count(&compiler, i, node->pos);
+
+    int distance = compiler.chunk->count - (jump + 2);
+    if (distance >= NO_OPERAND) {
+      compiler_error(&compiler, node->pos, "Default argument is too large");
+    }
+    chunk_patch_short(compiler.chunk, jump, (uint16_t)distance);
+  }
+
+  compiler.depth = 0;
+  adjust_depth(&compiler, param_count);
+  emit_byte(&compiler, OP_ENTER, node->pos);
+  adjust_depth(&compiler, -param_count);
+
+  compile_statement(&compiler, node->function_declaration.body);
+  emit_byte(&compiler, OP_RETURN_NOTHING, node->pos);
+
+  if (compiler.had_error) {
+    *had_error = true;
+  }
+  return compiler.chunk;
+}
+
+static void compile_statement(Compiler *compiler, ASTNode *node) {
+  if (!node)
+    return;
+
+  int region = begin_region(compiler, RECOVER_STATEMENT, 0);
+
+  switch (node->type) {
+  case AST_VARIABLE_DECLARATION: {
+    uint8_t flags = 0;
+    if (node->variable_declaration.initializer) {
+      compile_expression(compiler, node->variable_declaration.initializer);
+      flags |= DEFINE_HAS_VALUE;
+    }
+    if (node->variable_declaration.is_fixed) {
+      flags |= DEFINE_FIXED;
+    }
+
+    emit_byte(compiler, OP_DEFINE_NAME, node->pos);
+    emit_short(compiler,
+               chunk_add_name(compiler->chunk, node->variable_declaration.name),
+               node->pos);
+    emit_slot(compiler, node->variable_declaration.slot, node->pos);
+    if (node->variable_declaration.var_type) {
+      emit_short(compiler,
+                 chunk_add_type(compiler->chunk,
+                                node->variable_declaration.var_type),
+                 node->pos);
+    } else {
+      chunk_write_short(compiler->chunk, NO_OPERAND, node->pos);
+    }
+    emit_byte(compiler, flags, node->pos);
+    if (flags & DEFINE_HAS_VALUE) {
+      adjust_depth(compiler, -1);
+    }
+    break;
+  }
+
+  case AST_FUNCTION_DECLARATION: {
+    bool had_error = false;
+    Chunk *body = compile_function(node, compiler->count_scopes, &had_error);
+    if (had_error) {
+      compiler->had_error = true;
+    }
+    emit_byte(compiler, OP_DEFINE_FUNCTION, node->pos);
+    emit_short(compiler, chunk_add_function(compiler->chunk, node, body),
+               node->pos);
+    emit_slot(compiler, node->function_declaration.slot, node->pos);
+    break;
+  }
+
+  case AST_RETURN_STATEMENT:
+    if (node->return_statement.expression) {
+      compile_expression(compiler, node->return_statement.expression);
+    } else {
+      emit_byte(compiler, OP_NULL, node->pos);
+      adjust_depth(compiler, 1);
+    }
+    emit_byte(compiler, OP_RETURN, node->pos);
+    adjust_depth(compiler, -1);
+
+    // A failed return expression still ends the function, just without a
+    // value, so recovery lands on OP_RETURN_NOTHING rather than moving on.
+    end_region(compiler, region);
+    emit_byte(compiler, OP_RETURN_NOTHING, node->pos);
+    return;
+
+  case AST_EXPRESSION_STATEMENT:
+    compile_expression(compiler, node->expression_statement.expression);
+    emit_byte(compiler, OP_POP, node->pos);
+    adjust_depth(compiler, -1);
+    break;
+
+  case AST_BLOCK_STATEMENT:
+    if (node->block_statement.needs_scope) {
+      emit_byte(compiler, OP_PUSH_SCOPE, node->pos);
+      emit_slot(compiler, node->block_statement.scope_size, node->pos);
+    } else if (compiler->count_scopes) {
+      emit_byte(compiler, OP_SCOPE_ELIDED, node->pos);
+    }
+    for (int i = 0; i < node->block_statement.statement_count; i++) {
+      compile_statement(compiler, node->block_statement.statements[i]);
+    }
+    if (node->block_statement.needs_scope) {
+      emit_byte(compiler, OP_POP_SCOPE, node->pos);
+    }
+    break;
+
+  case AST_PRINT_STATEMENT:
+    compile_expression(compiler, node->print_statement.expression);
+    emit_byte(compiler, node->print_statement.newline ? OP_PRINTLN : OP_PRINT,
+              node->pos);
+    adjust_depth(compiler, -1);
+    break;
+
+  case AST_ASSIGNMENT_EXPRESSION:
+    compile_expression(compiler, node->assignment_expression.value);
+    emit_name(compiler, OP_SET_NAME, OP_SET_LOCAL,
+              node->assignment_expression.name,
+              node->assignment_expression.where, node->pos);
+    adjust_depth(compiler, -1);
+    break;
+
+  case AST_IMPORT_STATEMENT:
+    // Import handling should be done before interpretation
+    break;
+
+  default:
+    compile_expression(compiler, node);
+    emit_byte(compiler, OP_POP, node->pos);
+    adjust_depth(compiler, -1);
+    break;
+  }
+
+  end_region(compiler, region);
+}
+
+// A chunk is cut once any u16-indexed pool passes this, leaving the next
+// statement the rest of the range however many entries it adds.
+#define CHUNK_POOL_SPLIT (NO_OPERAND / 2)
+
+static bool chunk_is_full(const Chunk *chunk) {
+  return chunk->name_count > CHUNK_POOL_SPLIT ||
+         chunk->type_count > CHUNK_POOL_SPLIT ||
+         chunk->function_count > CHUNK_POOL_SPLIT ||
+         chunk->format_count > CHUNK_POOL_SPLIT ||
+         chunk->call_cache_count > CHUNK_POOL_SPLIT;
+}
+
+Chunk *compiler_compile(ASTNode *program, int *next, bool count_scopes) {
+  Compiler compiler = {chunk_create(), 0, 0, count_scopes, false};
+
+  int i = *next;
+  while (i < program->program.statement_count && !chunk_is_full(compiler.chunk)) {
+    compile_statement(&compiler, program->program.statements[i++]);
+  }
+  *next = i;
+  emit_byte(&compiler, OP_HALT, program->pos);
+
+  if (compiler.had_error) {
+    chunk_destroy(compiler.chunk);
+    return NULL;
+  }
+  return compiler.chunk;
+}
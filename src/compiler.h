@@ -0,0 +1,18 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "bytecode.h"
+#include "parser.h"
+
+// Translates a parsed program into bytecode for the VM. Function bodies are
+// compiled eagerly into nested chunks. Returns NULL if the tree contains a
+// construct the bytecode cannot express. With count_scopes set, blocks that
+// run in their enclosing scope leave a marker so the VM can count them.
+//
+// Top-level statements are compiled from `*next` on. A program too large
+// for the u16 pool operands of one chunk is cut between statements:
+// `*next` is left at the first statement not compiled, and the caller
+// compiles the rest into further chunks that run in the same scope.
+Chunk *compiler_compile(ASTNode *program, int *next, bool count_scopes);
+
+#endif
@@ -1,118 +1,370 @@
 #include "environment.h"
+#include "pool.h"
 #include <stdlib.h>
 #include <string.h>
 
+#define ENV_INITIAL_CAPACITY 4
+#define ENV_LINEAR_MAX 8     // Scopes up to this size are searched without an index
+#define SCOPE_SEGMENT_SIZE (64 * 1024)
+#define SCOPE_ALIGN(size) (((size) + 15) & ~(size_t)15)
+
+struct ScopeSegment {
+    ScopeSegment *prev;
+    ScopeSegment *next;     // Kept after a pop so the next push can reuse it
+    size_t used;
+    size_t size;
+};
+
+static char *scope_segment_data(ScopeSegment *segment) {
+    return (char *)segment + SCOPE_ALIGN(sizeof(ScopeSegment));
+}
+
+static ScopeSegment *scope_segment_create(ScopeSegment *prev, size_t size) {
+    ScopeSegment *segment = malloc(SCOPE_ALIGN(sizeof(ScopeSegment)) + size);
+    if (!segment) return NULL;
+
+    segment->prev = prev;
+    segment->next = NULL;
+    segment->used = 0;
+    segment->size = size;
+    return segment;
+}
+
+ScopeStack *scope_stack_create(void) {
+    ScopeStack *stack = malloc(sizeof(ScopeStack));
+    if (!stack) return NULL;
+
+    stack->top = scope_segment_create(NULL, SCOPE_SEGMENT_SIZE);
+    return stack;
+}
+
+void scope_stack_destroy(ScopeStack *stack) {
+    if (!stack) return;
+
+    ScopeSegment *segment = stack->top;
+    while (segment && segment->prev) {
+        segment = segment->prev;
+    }
+    while (segment) {
+        ScopeSegment *next = segment->next;
+        free(segment);
+        segment = next;
+    }
+    free(stack);
+}
+
 Environment *environment_create(Environment *parent) {
-    Environment *env = malloc(sizeof(Environment));
+    return environment_create_sized(parent, 0);
+}
+
+Environment *environment_create_sized(Environment *parent, int slot_count) {
+    Environment *env = pool_alloc(sizeof(Environment));
     if (!env) return NULL;
     
     env->entries = NULL;
+    if (slot_count > 0) {
+        env->entries = pool_alloc(sizeof(EnvEntry) * (size_t)slot_count);
+        if (env->entries) {
+            memset(env->entries, 0, sizeof(EnvEntry) * (size_t)slot_count);
+        }
+    }
+    env->count = 0;
+    env->capacity = env->entries ? slot_count : 0;
+    env->index = NULL;
+    env->index_capacity = 0;
     env->parent = parent;
+    env->segment = NULL;
+    env->owns_entries = true;
     return env;
 }
 
+static void environment_release_entries(Environment *env) {
+    for (int i = 0; i < env->count; i++) {
+        EnvEntry *entry = &env->entries[i];
+        if (!entry->symbol) continue;
+
+        entry->symbol->version++;
+        value_destroy(entry->value);
+    }
+    
+    if (env->owns_entries) {
+        pool_free(env->entries, sizeof(EnvEntry) * (size_t)env->capacity);
+    }
+    pool_free(env->index, sizeof(int) * (size_t)env->index_capacity);
+}
+
 void environment_destroy(Environment *env) {
     if (!env) return;
     
-    EnvEntry *current = env->entries;
-    while (current) {
-        EnvEntry *next = current->next;
-        free(current->name);
-        free(current->type);
-        value_destroy(current->value);
-        free(current);
-        current = next;
+    environment_release_entries(env);
+    pool_free(env, sizeof(Environment));
+}
+
+Environment *environment_push(ScopeStack *stack, Environment *parent, int slot_count) {
+    size_t header = SCOPE_ALIGN(sizeof(Environment));
+    size_t needed = header + sizeof(EnvEntry) * (size_t)slot_count;
+    ScopeSegment *segment = stack->top;
+
+    if (segment->used + needed > segment->size) {
+        // Segments past the top are empty; reuse the next one if it fits,
+        // otherwise splice in a fresh one large enough for this scope.
+        ScopeSegment *next = segment->next;
+        if (!next || needed > next->size) {
+            size_t size = needed > SCOPE_SEGMENT_SIZE ? needed : SCOPE_SEGMENT_SIZE;
+            ScopeSegment *fresh = scope_segment_create(segment, size);
+            if (!fresh) return NULL;
+
+            fresh->next = next;
+            if (next) next->prev = fresh;
+            segment->next = fresh;
+            next = fresh;
+        }
+        segment = next;
+        stack->top = segment;
     }
-    
-    free(env);
+
+    char *memory = scope_segment_data(segment) + segment->used;
+    segment->used += needed;
+
+    Environment *env = (Environment *)memory;
+    env->entries = slot_count > 0 ? (EnvEntry *)(memory + header) : NULL;
+    env->count = 0;
+    env->capacity = slot_count;
+    env->index = NULL;
+    env->index_capacity = 0;
+    env->parent = parent;
+    env->segment = segment;
+    env->owns_entries = false;
+    if (slot_count > 0) {
+        memset(env->entries, 0, sizeof(EnvEntry) * (size_t)slot_count);
+    }
+    return env;
 }
 
-bool environment_define(Environment *env, const char *name, Value *value, const char *type, bool is_fixed) {
-    if (!env || !name) return false;
-    
-    EnvEntry *current = env->entries;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return false;
+// `env` must be the most recently pushed scope that is still live.
+void environment_pop(ScopeStack *stack, Environment *env) {
+    if (!env) return;
+
+    environment_release_entries(env);
+
+    ScopeSegment *segment = env->segment;
+    segment->used = (size_t)((char *)env - scope_segment_data(segment));
+    stack->top = segment;
+}
+
+static int environment_index_start(Symbol *name, int capacity) {
+    // Symbols are unique, so the pointer itself is the key. Hashing it
+    // (rather than reading name->hash) keeps a probe to a single cache line.
+    uint64_t key = (uint64_t)(uintptr_t)name * 0x9E3779B97F4A7C15ull;
+    return (int)((key >> 32) & (uint64_t)(capacity - 1));
+}
+
+static void environment_index_insert(Environment *env, Symbol *name, int slot) {
+    int mask = env->index_capacity - 1;
+    int i = environment_index_start(name, env->index_capacity);
+
+    while (env->index[i]) {
+        i = (i + 1) & mask;
+    }
+    env->index[i] = slot + 1;
+}
+
+static void environment_build_index(Environment *env, int capacity) {
+    pool_free(env->index, sizeof(int) * (size_t)env->index_capacity);
+    env->index = pool_alloc(sizeof(int) * (size_t)capacity);
+    memset(env->index, 0, sizeof(int) * (size_t)capacity);
+    env->index_capacity = capacity;
+
+    for (int slot = 0; slot < env->count; slot++) {
+        if (env->entries[slot].symbol) {
+            environment_index_insert(env, env->entries[slot].symbol, slot);
         }
-        current = current->next;
     }
-   
-    EnvEntry *new_entry = malloc(sizeof(EnvEntry));
-    if (!new_entry) return false;
-    
-    new_entry->name = strdup(name);
-    new_entry->value = value ? value_copy(value) : NULL;
-    new_entry->type = type ? strdup(type) : NULL;
-    new_entry->is_fixed = is_fixed;
-    new_entry->is_initialized = (value != NULL);
-    new_entry->next = env->entries; 
-    
-    env->entries = new_entry;
-    return true;
 }
 
-Value *environment_get(Environment *env, const char *name) {
-    if (!env || !name) return NULL;
-    
-    Environment *current_env = env;
-    while (current_env) {
-        EnvEntry *current = current_env->entries;
-        while (current) {
-            if (strcmp(current->name, name) == 0) {
-                return current->value;
+static inline EnvEntry *environment_find_local(Environment *env, Symbol *name) {
+    if (!env->index) {
+        for (int slot = 0; slot < env->count; slot++) {
+            if (env->entries[slot].symbol == name) {
+                return &env->entries[slot];
             }
-            current = current->next;
         }
-        current_env = current_env->parent;
+        return NULL;
+    }
+
+    int mask = env->index_capacity - 1;
+    int i = environment_index_start(name, env->index_capacity);
+
+    while (env->index[i]) {
+        EnvEntry *entry = &env->entries[env->index[i] - 1];
+        if (entry->symbol == name) {
+            return entry;
+        }
+        i = (i + 1) & mask;
     }
-    
     return NULL;
 }
 
-bool environment_exists(Environment *env, const char *name) {
-    return environment_get(env, name) != NULL;
+static bool environment_reserve(Environment *env, int slot_count) {
+    if (slot_count <= env->capacity) return true;
+
+    int capacity = env->capacity ? env->capacity : ENV_INITIAL_CAPACITY;
+    while (capacity < slot_count) {
+        capacity *= 2;
+    }
+
+    // Scopes on the scope stack are sized by the resolver, so this only
+    // happens for unresolved code; such a scope moves its slots to the heap.
+    EnvEntry *entries = env->owns_entries
+        ? pool_realloc(env->entries, sizeof(EnvEntry) * (size_t)env->capacity,
+                       sizeof(EnvEntry) * (size_t)capacity)
+        : pool_alloc(sizeof(EnvEntry) * (size_t)capacity);
+    if (!entries) return false;
+
+    if (!env->owns_entries && env->capacity > 0) {
+        memcpy(entries, env->entries, sizeof(EnvEntry) * (size_t)env->capacity);
+    }
+    env->owns_entries = true;
+
+    memset(entries + env->capacity, 0, sizeof(EnvEntry) * (size_t)(capacity - env->capacity));
+    env->entries = entries;
+    env->capacity = capacity;
+    return true;
 }
 
-bool environment_set(Environment *env, const char *name, Value *value) {
-    if (!env || !name || !value) return false;
+// Binds `name` to `slot`. With `take` set, a value is moved into the entry
+// rather than copied and the caller's copy is cleared to none.
+static bool environment_bind(Environment *env, int slot, Symbol *name, Value *value,
+                             const Type *type, bool is_fixed, bool take) {
+    if (!env || !name || slot < 0) return false;
     
-    Environment *current_env = env;
-    while (current_env) {
-        EnvEntry *current = current_env->entries;
-        while (current) {
-            if (strcmp(current->name, name) == 0) {
-                if (current->is_fixed && current->is_initialized) {
-                    return false;
-                }
-                
-                value_destroy(current->value);
-                current->value = value_copy(value);
-                current->is_initialized = true;
-                return true;
-            }
-            current = current->next;
+    if (environment_find_local(env, name)) {
+        return false;
+    }
+    if (!environment_reserve(env, slot + 1)) {
+        return false;
+    }
+
+    EnvEntry *new_entry = &env->entries[slot];
+    if (new_entry->symbol) return false;
+
+    name->version++;
+    new_entry->symbol = name;
+    if (!value) {
+        new_entry->value = value_create_null();
+    } else if (take) {
+        new_entry->value = *value;
+        *value = value_none();
+    } else {
+        new_entry->value = value_copy(*value);
+    }
+    new_entry->type = type;
+    new_entry->is_fixed = is_fixed;
+    new_entry->is_initialized = (value != NULL);
+    if (slot >= env->count) {
+        env->count = slot + 1;
+    }
+
+    if (env->index) {
+        if (env->count * 2 > env->index_capacity) {
+            environment_build_index(env, env->index_capacity * 2);
+        } else {
+            environment_index_insert(env, name, slot);
         }
-        current_env = current_env->parent;
+    } else if (env->count > ENV_LINEAR_MAX) {
+        environment_build_index(env, ENV_LINEAR_MAX * 4);
+    }
+    return true;
+}
+
+bool environment_define_slot(Environment *env, int slot, Symbol *name, const Value *value,
+                             const Type *type, bool is_fixed) {
+    return environment_bind(env, slot, name, (Value *)value, type, is_fixed, false);
+}
+
+bool environment_define_slot_take(Environment *env, int slot, Symbol *name, Value *value,
+                                  const Type *type, bool is_fixed) {
+    return environment_bind(env, slot, name, value, type, is_fixed, true);
+}
+
+bool environment_define(Environment *env, Symbol *name, const Value *value, const Type *type, bool is_fixed) {
+    if (!env) return false;
+
+    return environment_define_slot(env, env->count, name, value, type, is_fixed);
+}
+
+bool environment_define_take(Environment *env, Symbol *name, Value *value, const Type *type, bool is_fixed) {
+    if (!env) return false;
+
+    return environment_define_slot_take(env, env->count, name, value, type, is_fixed);
+}
+
+Value *environment_get(Environment *env, Symbol *name) {
+    EnvEntry *entry = environment_get_entry(env, name);
+    if (!entry || !entry->is_initialized) return NULL;
+    
+    return &entry->value;
+}
+
+bool environment_exists(Environment *env, Symbol *name) {
+    return environment_get(env, name) != NULL;
+}
+
+bool environment_set(Environment *env, Symbol *name, Value value) {
+    return environment_set_entry(environment_get_entry(env, name), value);
+}
+
+static bool environment_assign(EnvEntry *entry, Value *value, bool take) {
+    if (!entry || value_is_none(*value)) return false;
+
+    if (entry->is_fixed && entry->is_initialized) {
+        return false;
     }
     
-    return false;
+    entry->symbol->version++;
+    value_destroy(entry->value);
+    if (take) {
+        entry->value = *value;
+        *value = value_none();
+    } else {
+        entry->value = value_copy(*value);
+    }
+    entry->is_initialized = true;
+    return true;
+}
+
+bool environment_set_entry(EnvEntry *entry, Value value) {
+    return environment_assign(entry, &value, false);
 }
 
-EnvEntry *environment_get_entry(Environment *env, const char *name) {
-    if (!env || !name) return NULL;
+bool environment_set_entry_take(EnvEntry *entry, Value *value) {
+    return environment_assign(entry, value, true);
+}
+
+EnvEntry *environment_get_entry(Environment *env, Symbol *name) {
+    if (!name) return NULL;
     
-    Environment *current_env = env;
-    while (current_env) {
-        EnvEntry *current = current_env->entries;
-        while (current) {
-            if (strcmp(current->name, name) == 0) {
-                return current;
-            }
-            current = current->next;
-        }
-        current_env = current_env->parent;
+    for (Environment *current_env = env; current_env; current_env = current_env->parent) {
+        EnvEntry *entry = environment_find_local(current_env, name);
+        if (entry) return entry;
     }
     
     return NULL;
-}
\ No newline at end of file
+}
+
+// A resolved slot is only empty if its declaration has not run (or failed),
+// in which case the name may still be bound further out, so fall back to a
+// full lookup by name.
+EnvEntry *environment_resolve(Environment *env, Symbol *name, EnvSlot where) {
+    if (where.depth >= 0) {
+        Environment *scope = env;
+        for (int i = 0; i < where.depth; i++) {
+            scope = scope->parent;
+        }
+        if (where.slot < scope->count && scope->entries[where.slot].symbol == name) {
+            return &scope->entries[where.slot];
+        }
+    }
+
+    return environment_get_entry(env, name);
+}
@@ -2,31 +2,94 @@
 #define ENVIRONMENT_H
 
 #include "value.h"
+#include "symbol.h"
 #include <stdbool.h>
 
 typedef struct EnvEntry {
-    char *name;
-    Value *value;
-    char *type;
+    Symbol *symbol;         // NULL for a slot that has not been declared yet
+    Value value;
+    const Type *type;       // Declared or inferred type; NULL accepts anything
     bool is_fixed;
     bool is_initialized;
-    struct EnvEntry *next;
 } EnvEntry;
 
-typedef struct Environment {
+// Where the resolver found a name: `slot` in the scope `depth` levels above
+// the current one. Names the resolver cannot pin down statically (globals
+// and anything free in a function, since function scopes chain to the
+// caller) have a negative depth and are looked up by symbol.
+typedef struct {
+    int depth;
+    int slot;
+} EnvSlot;
+
+#define ENV_SLOT_DYNAMIC ((EnvSlot){-1, -1})
+
+typedef struct ScopeSegment ScopeSegment;
+typedef struct Environment Environment;
+
+// Remembers what a call site's name resolved to. Without closures the
+// scopes on the lookup chain are exactly the live scopes, so the answer
+// can only change when a binding of the name is defined, assigned or goes
+// out of scope, all of which bump the symbol's version. The global scope
+// tells apart module code run by a different interpreter.
+typedef struct {
+    Function *function;     // Borrowed from the binding it was found in
+    Environment *globals;
+    uint64_t version;
+} CallCache;
+
+// Each scope is a flat array of entries indexed by slot. Resolved code
+// declares names at fixed slots; dynamic declarations (globals, modules)
+// append. A symbol index is only built once a scope grows past a handful
+// of names, so small function and block scopes are scanned linearly.
+// Entry pointers are invalidated by the next define in the same scope.
+struct Environment {
     EnvEntry *entries;
+    int count;              // One past the highest slot in use
+    int capacity;
+    int *index;             // Open addressing, symbol -> slot + 1; 0 is free
+    int index_capacity;
     struct Environment *parent;
-} Environment;
+    ScopeSegment *segment;  // Scope stack segment holding this scope, or NULL
+    bool owns_entries;      // entries was malloc'd rather than carved from a segment
+};
+
+// Function and block scopes never outlive the code that created them
+// (nothing captures a scope), so they are carved off a stack of large
+// segments together with their slots and released in LIFO order. Entering
+// a scope only allocates when the stack needs a new segment.
+typedef struct ScopeStack {
+    ScopeSegment *top;      // Segment holding the most recent scope
+} ScopeStack;
+
+ScopeStack *scope_stack_create(void);
+void scope_stack_destroy(ScopeStack *stack);
 
 Environment *environment_create(Environment *parent);
+Environment *environment_create_sized(Environment *parent, int slot_count);
 void environment_destroy(Environment *env);
-bool environment_define(Environment *env, const char *name, Value *value, const char *type, bool is_fixed);
-Value *environment_get(Environment *env, const char *name);
-bool environment_exists(Environment *env, const char *name);
-bool environment_set(Environment *env, const char *name, Value *value);
-EnvEntry *environment_get_entry(Environment *env, const char *name);  
+Environment *environment_push(ScopeStack *stack, Environment *parent, int slot_count);
+void environment_pop(ScopeStack *stack, Environment *env);
+bool environment_define(Environment *env, Symbol *name, const Value *value, const Type *type, bool is_fixed);
+bool environment_define_slot(Environment *env, int slot, Symbol *name, const Value *value,
+                             const Type *type, bool is_fixed);
+Value *environment_get(Environment *env, Symbol *name);
+bool environment_exists(Environment *env, Symbol *name);
+bool environment_set(Environment *env, Symbol *name, Value value);
+bool environment_set_entry(EnvEntry *entry, Value value);
+
+// Variants that move `*value` into the entry instead of copying it. On
+// success the caller's value is cleared to none; on failure it is left
+// alone, so destroying it afterwards is correct either way.
+bool environment_define_take(Environment *env, Symbol *name, Value *value, const Type *type,
+                             bool is_fixed);
+bool environment_define_slot_take(Environment *env, int slot, Symbol *name, Value *value,
+                                  const Type *type, bool is_fixed);
+bool environment_set_entry_take(EnvEntry *entry, Value *value);
+EnvEntry *environment_get_entry(Environment *env, Symbol *name);
+EnvEntry *environment_resolve(Environment *env, Symbol *name, EnvSlot where);
 
 #define environment_define_default(env, name, value, type) \
     environment_define(env, name, value, type, false)
 
-#endif
\ No newline at end of file
+#endif
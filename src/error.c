@@ -2,7 +2,7 @@
 
 // Global error state to prevent spam
 static bool error_reported_at_position = false;
-static Position last_error_pos = {0, 0, NULL};
+static Position last_error_pos = {POSITION_NO_OFFSET, -1};
 
 const char *error_type_to_string(ErrorType type) {
     switch (type) {
@@ -16,10 +16,11 @@ const char *error_type_to_string(ErrorType type) {
 }
 
 bool is_same_position(Position pos1, Position pos2) {
-    return pos1.line == pos2.line && 
-           pos1.column == pos2.column && 
-           pos1.filename && pos2.filename &&
-           strcmp(pos1.filename, pos2.filename) == 0;
+    const char *filename1 = position_filename(pos1);
+    const char *filename2 = position_filename(pos2);
+    return filename1 && filename2 && strcmp(filename1, filename2) == 0 &&
+           position_line(pos1) == position_line(pos2) &&
+           position_column(pos1) == position_column(pos2);
 }
 
 int get_error_highlight_width(ErrorType type, const char *code_line, int column) {
@@ -183,12 +184,16 @@ void error_report(ErrorType type, Position pos, const char *message, const char
         return;
     }
     
+    const char *filename = position_filename(pos);
+    int line = position_line(pos);
+    int column = position_column(pos);
+    
     printf("\n🦎 \033[1;31m%s\033[0m in \033[1m%s:%d:%d\033[0m\n", 
-           error_type_to_string(type), pos.filename, pos.line, pos.column);
+           error_type_to_string(type), filename, line, column);
     
     printf("   \033[1;31mError:\033[0m %s\n", message);
     
-    error_show_code_context_smart(pos.filename, pos.line, pos.column, type);
+    error_show_code_context_smart(filename, line, column, type);
     
     if (suggestion) {
         printf("   \033[1;36mNote:\033[0m %s\n", suggestion);
@@ -212,15 +217,19 @@ void error_report_with_code(ErrorType type, Position pos, const char *message,
         return;
     }
     
+    const char *filename = position_filename(pos);
+    int line = position_line(pos);
+    int column = position_column(pos);
+    
     printf("\n🦎 \033[1;31m%s\033[0m in \033[1m%s:%d:%d\033[0m\n", 
-           error_type_to_string(type), pos.filename, pos.line, pos.column);
+           error_type_to_string(type), filename, line, column);
     
     printf("   \033[1;31mError:\033[0m %s\n", message);
     
     if (code_snippet) {
-        printf("   %d | %s\n", pos.line, code_snippet);
+        printf("   %d | %s\n", line, code_snippet);
         printf("     | ");
-        for (int i = 1; i < pos.column; i++) {
+        for (int i = 1; i < column; i++) {
             printf(" ");
         }
         printf("^^^^^^^\n\n");
@@ -248,12 +257,16 @@ void error_report_with_recovery(ErrorType type, Position pos, const char *messag
         return;
     }
     
+    const char *filename = position_filename(pos);
+    int line = position_line(pos);
+    int column = position_column(pos);
+    
     printf("\n🦎 \033[1;31m%s\033[0m in \033[1m%s:%d:%d\033[0m\n", 
-           error_type_to_string(type), pos.filename, pos.line, pos.column);
+           error_type_to_string(type), filename, line, column);
     
     printf("   \033[1;31mError:\033[0m %s\n", message);
     
-    error_show_code_context_smart(pos.filename, pos.line, pos.column, type);
+    error_show_code_context_smart(filename, line, column, type);
     
     if (suggestion) {
         printf("   \033[1;36mNote:\033[0m %s\n", suggestion);
@@ -276,12 +289,16 @@ void error_report_with_recovery(ErrorType type, Position pos, const char *messag
 }
 
 void error_report_type_fatal(Position pos, const char *message, const char *suggestion) {
+    const char *filename = position_filename(pos);
+    int line = position_line(pos);
+    int column = position_column(pos);
+    
     printf("\n🦎 \033[1;31m%s\033[0m in \033[1m%s:%d:%d\033[0m\n", 
-           error_type_to_string(ERROR_TYPE), pos.filename, pos.line, pos.column);
+           error_type_to_string(ERROR_TYPE), filename, line, column);
     
     printf("   \033[1;31mFatal Error:\033[0m %s\n", message);
     
-    error_show_code_context_smart(pos.filename, pos.line, pos.column, ERROR_TYPE);
+    error_show_code_context_smart(filename, line, column, ERROR_TYPE);
     
     if (suggestion) {
         printf("   \033[1;36mNote:\033[0m %s\n", suggestion);
@@ -294,7 +311,5 @@ void error_report_type_fatal(Position pos, const char *message, const char *sugg
 
 void error_reset_state(void) {
     error_reported_at_position = false;
-    last_error_pos.line = 0;
-    last_error_pos.column = 0;
-    last_error_pos.filename = NULL;
+    last_error_pos = POSITION_NONE;
 }
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "import.h"
+#include "source.h"
 #include "lexer.h"
 #include "parser.h"
+#include "optimizer.h"
+#include "resolver.h"
 #include "error.h"
+#include "vm.h"
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -20,6 +24,11 @@ void import_manager_destroy(ImportManager *manager) {
         free(current->name);
         free(current->path);
         environment_destroy(current->env);
+        arena_destroy(current->arena);
+        for (int i = 0; i < current->program_count; i++) {
+            chunk_destroy(current->programs[i]);
+        }
+        free(current->programs);
         free(current);
         current = next;
     }
@@ -49,24 +58,6 @@ static char *resolve_module_path(const char *module_path) {
     return NULL;
 }
 
-static char *read_file(const char *filepath) {
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        return NULL;
-    }
-    
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char *content = malloc(length + 1);
-    fread(content, 1, length, file);
-    content[length] = '\0';
-    
-    fclose(file);
-    return content;
-}
-
 bool import_process_module(ImportManager *manager, Interpreter *interpreter, 
                           const char *module_path, const char *alias) {
     ImportedModule *current = manager->modules;
@@ -79,73 +70,91 @@ bool import_process_module(ImportManager *manager, Interpreter *interpreter,
     
     char *resolved_path = resolve_module_path(module_path);
     if (!resolved_path) {
-        Position pos = {0, 0, (char*)module_path};
+        Position pos = position_for_file(module_path);
         error_report(ERROR_IMPORT, pos, "Module not found", 
                    "Check if the module file exists and the path is correct");
         return false;
     }
 
-    char *source = read_file(resolved_path);
-    if (!source) {
-        Position pos = {0, 0, (char*)module_path};
+    SourceText source;
+    if (!source_load(resolved_path, &source)) {
+        Position pos = position_for_file(module_path);
         error_report(ERROR_IMPORT, pos, "Cannot read module file", 
                    "Check file permissions and accessibility");
         free(resolved_path);
         return false;
     }
     
-    Lexer *lexer = lexer_create(source, resolved_path);
-    Token *tokens = lexer_tokenize(lexer);
+    Lexer *lexer = lexer_create(source.text, source.length, resolved_path);
+    if (!lexer) {
+        source_release(&source);
+        free(resolved_path);
+        return false;
+    }
     
-    Parser *parser = parser_create(tokens, lexer->token_count);
+    Arena *arena = arena_create();
+    Parser *parser = parser_create(lexer, arena);
     ASTNode *ast = parser_parse(parser);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    source_release(&source);
     
     if (!ast) {
-        Position pos = {0, 0, resolved_path};
+        Position pos = position_for_file(resolved_path);
         error_report(ERROR_IMPORT, pos, "Failed to parse module", 
                    "Check module syntax");
-        free(source);
+        arena_destroy(arena);
         free(resolved_path);
-        lexer_destroy(lexer);
-        parser_destroy(parser);
         return false;
     }
+    if (interpreter->optimize_level > 0) {
+        optimizer_run(ast, arena, true);
+    }
+    resolver_resolve(ast);
     
     Environment *module_env = environment_create(NULL);
     
     Interpreter *module_interpreter = interpreter_create();
+    module_interpreter->tree_walk = interpreter->tree_walk;
+    module_interpreter->collect_stats = interpreter->collect_stats;
+    module_interpreter->optimize_level = interpreter->optimize_level;
+    module_interpreter->max_call_depth = interpreter->max_call_depth;
     module_interpreter->global_env = module_env;
     module_interpreter->current_env = module_env;
     
     interpreter_run(module_interpreter, ast);
+    interpreter_stats_add(&interpreter->stats, &module_interpreter->stats);
     
     ImportedModule *new_module = malloc(sizeof(ImportedModule));
     new_module->name = strdup(alias ? alias : module_path);
     new_module->path = strdup(resolved_path);
     new_module->env = module_env;
+    new_module->arena = arena;
+    new_module->programs = NULL;
+    new_module->program_count = 0;
+    if (module_interpreter->vm) {
+        new_module->programs = vm_take_programs(module_interpreter->vm,
+                                                &new_module->program_count);
+    }
     new_module->next = manager->modules;
     manager->modules = new_module;
     
-    EnvEntry *entry = module_env->entries;
-    while (entry) {
-        if (entry->value->type == VALUE_FUNCTION) {
-            Function *func = entry->value->function_val;
+    for (int i = 0; i < module_env->count; i++) {
+        EnvEntry *entry = &module_env->entries[i];
+        if (entry->symbol && entry->value.type == VALUE_FUNCTION) {
+            Function *func = entry->value.function_val;
             if (func->is_public) {
                 char qualified_name[256];
                 snprintf(qualified_name, sizeof(qualified_name), "%s.%s", 
-                        new_module->name, entry->name);
-                environment_define_default(interpreter->current_env, qualified_name, 
-                                 entry->value, entry->type);
+                        new_module->name, entry->symbol->name);
+                environment_define_default(interpreter->current_env,
+                                 symbol_intern(qualified_name),
+                                 &entry->value, entry->type);
             }
         }
-        entry = entry->next;
     }
     
-    free(source);
     free(resolved_path);
-    ast_destroy(ast);
-    lexer_destroy(lexer);
-    parser_destroy(parser);
     
     module_interpreter->global_env = NULL;
     interpreter_destroy(module_interpreter);
@@ -180,13 +189,13 @@ bool import_process_statement(ImportManager *manager, Interpreter *interpreter,
         
         for (int i = 0; i < import_node->import_statement.name_count; i++) {
             const char *func_name = import_node->import_statement.names[i];
-            Value *func_value = environment_get(module_env, func_name);
+            Value *func_value = environment_get(module_env, symbol_intern(func_name));
             
             if (func_value && func_value->type == VALUE_FUNCTION) {
                 Function *func = func_value->function_val;
                 if (func->is_public) {
-                    environment_define_default(interpreter->current_env, func_name, 
-                                     func_value, "function");
+                    environment_define_default(interpreter->current_env, symbol_intern(func_name), 
+                                     func_value, type_of_value(*func_value));
                 } else {
                     Position pos = import_node->pos;
                     error_report(ERROR_IMPORT, pos, "Function is not public", 
@@ -4,12 +4,16 @@
 #include "parser.h"
 #include "environment.h"
 #include "interpreter.h"
+#include "bytecode.h"
 #include <stdbool.h>
 
 typedef struct ImportedModule {
     char *name;
     char *path;
     Environment *env;
+    Arena *arena;           // The module's tree; its functions point into it
+    Chunk **programs;       // The module compiled for the VM, which its
+    int program_count;      // functions run; NULL when tree walking
     struct ImportedModule *next;
 } ImportedModule;
 
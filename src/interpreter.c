@@ -1,28 +1,15 @@
 #include "interpreter.h"
 #include "error.h"
 #include "parser.h"
+#include "vm.h"
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
-static bool is_compatible_type(Value *value, const char *expected_type) {
-  if (!expected_type)
-    return true; // No return type specified
+#define CALL_INLINE_ARGS 8  // Arguments evaluated without a heap buffer
 
-  if (strcmp(expected_type, "int") == 0) {
-    return value->type == VALUE_INT;
-  } else if (strcmp(expected_type, "float") == 0) {
-    return value->type == VALUE_FLOAT;
-  } else if (strcmp(expected_type, "string") == 0) {
-    return value->type == VALUE_STRING;
-  } else if (strcmp(expected_type, "bool") == 0) {
-    return value->type == VALUE_BOOL;
-  } else if (strcmp(expected_type, "void") == 0) {
-    return value->type == VALUE_NULL;
-  }
-
-  return false;
-}
-
-static const char *get_value_type_name(Value *value) {
-  switch (value->type) {
+static const char *get_value_type_name(Value value) {
+  switch (value.type) {
   case VALUE_INT:
     return "int";
   case VALUE_FLOAT:
@@ -44,530 +31,810 @@ Interpreter *interpreter_create(void) {
   Interpreter *interpreter = malloc(sizeof(Interpreter));
   interpreter->global_env = environment_create(NULL);
   interpreter->current_env = interpreter->global_env;
+  interpreter->scopes = scope_stack_create();
   interpreter->return_flag = false;
-  interpreter->return_value = NULL;
+  interpreter->return_value = value_none();
+  interpreter->tree_walk = false;
+  interpreter->vm = NULL;
+  interpreter->collect_stats = false;
+  interpreter->optimize_level = 1;
+  interpreter->max_call_depth = CALL_DEPTH_DEFAULT;
+  interpreter->call_depth = 0;
+  interpreter->halted = false;
+  interpreter->stack_base = NULL;
+  interpreter->stack_budget = 0;
+  interpreter->stats = (InterpreterStats){0};
   return interpreter;
 }
 
 void interpreter_destroy(Interpreter *interpreter) {
   if (interpreter) {
     environment_destroy(interpreter->global_env);
-    if (interpreter->return_value) {
-      value_destroy(interpreter->return_value);
-    }
+    value_destroy(interpreter->return_value);
+    vm_destroy(interpreter->vm);
+    scope_stack_destroy(interpreter->scopes);
     free(interpreter);
   }
 }
 
-static Value *evaluate_binary_expression(Interpreter *interpreter,
-                                         ASTNode *node) {
-  Value *left = interpreter_evaluate(interpreter, node->binary_expression.left);
-  Value *right =
-      interpreter_evaluate(interpreter, node->binary_expression.right);
+Value interpreter_binary_operation(TokenType operator, Value left, Value right,
+                                   Position pos) {
+  Value result = value_none();
 
-  if (!left || !right) {
-    if (left)
-      value_destroy(left);
-    if (right)
-      value_destroy(right);
-    return NULL;
-  }
-
-  Value *result = NULL;
-
-  switch (node->binary_expression.operator) {
+  switch (operator) {
   case TOKEN_PLUS:
-    if (left->type == VALUE_STRING || right->type == VALUE_STRING) {
-      char *left_str = value_to_string(left);
-      char *right_str = value_to_string(right);
-      size_t len = strlen(left_str) + strlen(right_str) + 1;
-      char *concat = malloc(len);
-      strcpy(concat, left_str);
-      strcat(concat, right_str);
-      result = value_create_string(concat);
-      free(concat);
-      free(left_str);
-      free(right_str);
-    } else if (left->type == VALUE_INT && right->type == VALUE_INT) {
-      result = value_create_int(left->int_val + right->int_val);
-    } else if ((left->type == VALUE_INT || left->type == VALUE_FLOAT) &&
-               (right->type == VALUE_INT || right->type == VALUE_FLOAT)) {
+    if (left.type == VALUE_STRING || right.type == VALUE_STRING) {
+      char left_buffer[VALUE_TEXT_SIZE], right_buffer[VALUE_TEXT_SIZE];
+      size_t left_length, right_length;
+      const char *left_text = value_text(left, left_buffer, &left_length);
+      const char *right_text = value_text(right, right_buffer, &right_length);
+      String *concat = string_alloc(left_length + right_length);
+      memcpy(concat->chars, left_text, left_length);
+      memcpy(concat->chars + left_length, right_text, right_length);
+      result = value_from_string(concat);
+    } else if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      result = value_create_int(left.int_val + right.int_val);
+    } else if ((left.type == VALUE_INT || left.type == VALUE_FLOAT) &&
+               (right.type == VALUE_INT || right.type == VALUE_FLOAT)) {
       double left_val =
-          (left->type == VALUE_INT) ? left->int_val : left->float_val;
+          (left.type == VALUE_INT) ? left.int_val : left.float_val;
       double right_val =
-          (right->type == VALUE_INT) ? right->int_val : right->float_val;
+          (right.type == VALUE_INT) ? right.int_val : right.float_val;
       result = value_create_float(left_val + right_val);
     }
     break;
 
   case TOKEN_MINUS:
-    if (left->type == VALUE_INT && right->type == VALUE_INT) {
-      result = value_create_int(left->int_val - right->int_val);
-    } else if ((left->type == VALUE_INT || left->type == VALUE_FLOAT) &&
-               (right->type == VALUE_INT || right->type == VALUE_FLOAT)) {
+    if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      result = value_create_int(left.int_val - right.int_val);
+    } else if ((left.type == VALUE_INT || left.type == VALUE_FLOAT) &&
+               (right.type == VALUE_INT || right.type == VALUE_FLOAT)) {
       double left_val =
-          (left->type == VALUE_INT) ? left->int_val : left->float_val;
+          (left.type == VALUE_INT) ? left.int_val : left.float_val;
       double right_val =
-          (right->type == VALUE_INT) ? right->int_val : right->float_val;
+          (right.type == VALUE_INT) ? right.int_val : right.float_val;
       result = value_create_float(left_val - right_val);
     }
     break;
 
   case TOKEN_MULTIPLY:
-    if (left->type == VALUE_INT && right->type == VALUE_INT) {
-      result = value_create_int(left->int_val * right->int_val);
-    } else if ((left->type == VALUE_INT || left->type == VALUE_FLOAT) &&
-               (right->type == VALUE_INT || right->type == VALUE_FLOAT)) {
+    if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      result = value_create_int(left.int_val * right.int_val);
+    } else if ((left.type == VALUE_INT || left.type == VALUE_FLOAT) &&
+               (right.type == VALUE_INT || right.type == VALUE_FLOAT)) {
       double left_val =
-          (left->type == VALUE_INT) ? left->int_val : left->float_val;
+          (left.type == VALUE_INT) ? left.int_val : left.float_val;
       double right_val =
-          (right->type == VALUE_INT) ? right->int_val : right->float_val;
+          (right.type == VALUE_INT) ? right.int_val : right.float_val;
       result = value_create_float(left_val * right_val);
     }
     break;
 
   case TOKEN_DIVIDE:
-    if ((left->type == VALUE_INT || left->type == VALUE_FLOAT) &&
-        (right->type == VALUE_INT || right->type == VALUE_FLOAT)) {
+    if ((left.type == VALUE_INT || left.type == VALUE_FLOAT) &&
+        (right.type == VALUE_INT || right.type == VALUE_FLOAT)) {
       double left_val =
-          (left->type == VALUE_INT) ? left->int_val : left->float_val;
+          (left.type == VALUE_INT) ? left.int_val : left.float_val;
       double right_val =
-          (right->type == VALUE_INT) ? right->int_val : right->float_val;
+          (right.type == VALUE_INT) ? right.int_val : right.float_val;
       if (right_val == 0) {
-        error_report(ERROR_RUNTIME, node->pos, "Division by zero",
+        error_report(ERROR_RUNTIME, pos, "Division by zero",
                      "Check the divisor value before performing division");
-        value_destroy(left);
-        value_destroy(right);
-        return NULL;
+        return value_none();
       }
       result = value_create_float(left_val / right_val);
     }
     break;
 
   case TOKEN_MODULO:
-    if (left->type == VALUE_INT && right->type == VALUE_INT) {
-      if (right->int_val == 0) {
-        error_report(ERROR_RUNTIME, node->pos, "Modulo by zero",
+    if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      if (right.int_val == 0) {
+        error_report(ERROR_RUNTIME, pos, "Modulo by zero",
                      "Check the divisor value before performing modulo operation");
-        value_destroy(left);
-        value_destroy(right);
-        return NULL;
+        return value_none();
       }
-      result = value_create_int(left->int_val % right->int_val);
+      result = value_create_int(left.int_val % right.int_val);
     } else {
-      error_report(ERROR_RUNTIME, node->pos, "Modulo operation requires integer operands",
+      error_report(ERROR_RUNTIME, pos, "Modulo operation requires integer operands",
                    "Use integer values for modulo operation");
     }
     break;
-    
+
   case TOKEN_INT_DIVIDE:
-    if (left->type == VALUE_INT && right->type == VALUE_INT) {
-      if (right->int_val == 0) {
-        error_report(ERROR_RUNTIME, node->pos, "Integer division by zero",
+    if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      if (right.int_val == 0) {
+        error_report(ERROR_RUNTIME, pos, "Integer division by zero",
                      "Check the divisor value before performing integer division");
-        value_destroy(left);
-        value_destroy(right);
-        return NULL;
+        return value_none();
       }
-      result = value_create_int(left->int_val / right->int_val);
+      result = value_create_int(left.int_val / right.int_val);
     } else {
-      error_report(ERROR_RUNTIME, node->pos, "Integer division requires integer operands",
+      error_report(ERROR_RUNTIME, pos, "Integer division requires integer operands",
                    "Use integer values for integer division operation");
     }
     break;
 
   default:
-    error_report(ERROR_RUNTIME, node->pos, "Unsupported binary operator",
+    error_report(ERROR_RUNTIME, pos, "Unsupported binary operator",
                  "Use supported operators: +, -, *, /, %, %%");
     break;
   }
 
-  value_destroy(left);
-  value_destroy(right);
   return result;
 }
 
-static Value *evaluate_unary_expression(Interpreter *interpreter,
+// The specialized paths. Each gives the same result as
+// interpreter_binary_operation for its operand types, and returns false
+// for the cases that must go through it after all (zero divisors, which
+// report an error, and operators without a fast path).
+static inline bool binary_int_operation(TokenType operator, int left,
+                                        int right, Value *result) {
+  switch (operator) {
+  case TOKEN_PLUS:
+    *result = value_create_int(left + right);
+    return true;
+  case TOKEN_MINUS:
+    *result = value_create_int(left - right);
+    return true;
+  case TOKEN_MULTIPLY:
+    *result = value_create_int(left * right);
+    return true;
+  case TOKEN_MODULO:
+    if (right == 0)
+      return false;
+    *result = value_create_int(left % right);
+    return true;
+  case TOKEN_INT_DIVIDE:
+    if (right == 0)
+      return false;
+    *result = value_create_int(left / right);
+    return true;
+  default:
+    return false;
+  }
+}
+
+static inline bool binary_float_operation(TokenType operator, double left,
+                                          double right, Value *result) {
+  switch (operator) {
+  case TOKEN_PLUS:
+    *result = value_create_float(left + right);
+    return true;
+  case TOKEN_MINUS:
+    *result = value_create_float(left - right);
+    return true;
+  case TOKEN_MULTIPLY:
+    *result = value_create_float(left * right);
+    return true;
+  case TOKEN_DIVIDE:
+    if (right == 0)
+      return false;
+    *result = value_create_float(left / right);
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Picks the specialization for a site's first operands. Operators with no
+// fast path for those types go generic straight away.
+static BinarySpecialization binary_specialize(TokenType operator, Value left,
+                                              Value right) {
+  if (left.type == VALUE_INT && right.type == VALUE_INT &&
+      (operator == TOKEN_PLUS || operator == TOKEN_MINUS ||
+       operator == TOKEN_MULTIPLY || operator == TOKEN_MODULO ||
+       operator == TOKEN_INT_DIVIDE))
+    return BINARY_INT;
+  if (left.type == VALUE_FLOAT && right.type == VALUE_FLOAT &&
+      (operator == TOKEN_PLUS || operator == TOKEN_MINUS ||
+       operator == TOKEN_MULTIPLY || operator == TOKEN_DIVIDE))
+    return BINARY_FLOAT;
+  return BINARY_GENERIC;
+}
+
+static Value evaluate_binary_expression(Interpreter *interpreter,
                                         ASTNode *node) {
-  Value *operand =
-      interpreter_evaluate(interpreter, node->unary_expression.operand);
-  if (!operand)
-    return NULL;
+  Value left = interpreter_evaluate(interpreter, node->binary_expression.left);
+  Value right =
+      interpreter_evaluate(interpreter, node->binary_expression.right);
+
+  if (value_is_none(left) || value_is_none(right)) {
+    value_destroy(left);
+    value_destroy(right);
+    return value_none();
+  }
+
+  // A failed type guard sends the site to the generic path for good. A
+  // zero divisor passes the guard and only this evaluation goes generic,
+  // to report the error.
+  TokenType operator = node->binary_expression.operator;
+  Value result;
+  switch (node->binary_expression.specialization) {
+  case BINARY_INT:
+    if (left.type == VALUE_INT && right.type == VALUE_INT) {
+      if (binary_int_operation(operator, left.int_val, right.int_val,
+                               &result)) {
+        INTERPRETER_COUNT(interpreter, binary_fast);
+        return result;
+      }
+      break;
+    }
+    node->binary_expression.specialization = BINARY_GENERIC;
+    INTERPRETER_COUNT(interpreter, binary_despecialized);
+    break;
+  case BINARY_FLOAT:
+    if (left.type == VALUE_FLOAT && right.type == VALUE_FLOAT) {
+      if (binary_float_operation(operator, left.float_val, right.float_val,
+                                 &result)) {
+        INTERPRETER_COUNT(interpreter, binary_fast);
+        return result;
+      }
+      break;
+    }
+    node->binary_expression.specialization = BINARY_GENERIC;
+    INTERPRETER_COUNT(interpreter, binary_despecialized);
+    break;
+  case BINARY_UNSPECIALIZED:
+    node->binary_expression.specialization =
+        binary_specialize(operator, left, right);
+    break;
+  case BINARY_GENERIC:
+    break;
+  }
 
-  Value *result = NULL;
+  result = interpreter_binary_operation(operator, left, right, node->pos);
 
-  switch (node->unary_expression.operator) {
+  value_destroy(left);
+  value_destroy(right);
+  return result;
+}
+
+Value interpreter_unary_operation(TokenType operator, Value operand,
+                                  Position pos) {
+  Value result = value_none();
+
+  switch (operator) {
   case TOKEN_MINUS:
-    if (operand->type == VALUE_INT) {
-      result = value_create_int(-operand->int_val);
-    } else if (operand->type == VALUE_FLOAT) {
-      result = value_create_float(-operand->float_val);
+    if (operand.type == VALUE_INT) {
+      result = value_create_int(-operand.int_val);
+    } else if (operand.type == VALUE_FLOAT) {
+      result = value_create_float(-operand.float_val);
     } else {
-      error_report(ERROR_RUNTIME, node->pos, "Cannot negate non-numeric value",
+      error_report(ERROR_RUNTIME, pos, "Cannot negate non-numeric value",
                    "Use unary minus only with numbers");
     }
     break;
 
   default:
-    error_report(ERROR_RUNTIME, node->pos, "Unsupported unary operator",
+    error_report(ERROR_RUNTIME, pos, "Unsupported unary operator",
                  "Use supported unary operators");
     break;
   }
 
+  return result;
+}
+
+static Value evaluate_unary_expression(Interpreter *interpreter,
+                                       ASTNode *node) {
+  Value operand =
+      interpreter_evaluate(interpreter, node->unary_expression.operand);
+  if (value_is_none(operand))
+    return value_none();
+
+  Value result = interpreter_unary_operation(node->unary_expression.operator,
+                                              operand, node->pos);
+
   value_destroy(operand);
   return result;
 }
 
-static Value *evaluate_function_call(Interpreter *interpreter, ASTNode *node) {
-  Value *func_value =
-      environment_get(interpreter->current_env, node->function_call.name);
-  if (!func_value || func_value->type != VALUE_FUNCTION) {
-    error_report(ERROR_RUNTIME, node->pos, "Function not found or not callable",
+Function *interpreter_resolve_callee(Interpreter *interpreter, Symbol *name,
+                                     EnvSlot where, int provided_args,
+                                     CallCache *cache, Position pos) {
+  if (cache->function && cache->version == name->version &&
+      cache->globals == interpreter->global_env) {
+    INTERPRETER_COUNT(interpreter, call_cache_hits);
+    return cache->function;
+  }
+  INTERPRETER_COUNT(interpreter, call_cache_misses);
+
+  EnvEntry *entry = environment_resolve(interpreter->current_env, name, where);
+  if (!entry || !entry->is_initialized ||
+      entry->value.type != VALUE_FUNCTION) {
+    error_report(ERROR_RUNTIME, pos, "Function not found or not callable",
                  "Check if the function is defined and accessible");
     return NULL;
   }
 
-  Function *func = func_value->function_val;
-  int provided_args = node->function_call.argument_count;
+  Function *func = entry->value.function_val;
   int required_args = func->param_count;
-  
-  int min_required_args = 0;
-  for (int i = 0; i < func->param_count; i++) {
-    if (!func->param_has_default[i]) {
-      min_required_args++;
-    }
-  }
-  
+  int min_required_args = func->required_param_count;
+
   if (provided_args < min_required_args || provided_args > required_args) {
     char error_msg[256];
     if (min_required_args == required_args) {
-      snprintf(error_msg, sizeof(error_msg), 
+      snprintf(error_msg, sizeof(error_msg),
                "Function '%s' expects %d arguments, got %d",
                func->name, required_args, provided_args);
     } else {
-      snprintf(error_msg, sizeof(error_msg), 
+      snprintf(error_msg, sizeof(error_msg),
                "Function '%s' expects %d-%d arguments, got %d",
                func->name, min_required_args, required_args, provided_args);
     }
-    error_report(ERROR_RUNTIME, node->pos, error_msg,
+    error_report(ERROR_RUNTIME, pos, error_msg,
                  "Check the function signature and provide the correct number of arguments");
     return NULL;
   }
 
-  Environment *func_env = environment_create(interpreter->current_env);
-
-  for (int i = 0; i < func->param_count; i++) {
-    Value *arg_value = NULL;
-    char *param_type = func->param_types[i];
-    
-    if (i < provided_args) {
-      arg_value = interpreter_evaluate(interpreter, node->function_call.arguments[i]);
-      if (!arg_value) {
-        environment_destroy(func_env);
-        return NULL;
-      }
-
-      if (!param_type) {
-        param_type = infer_type_from_value(arg_value);
-        if (func->param_types[i]) {
-          free(func->param_types[i]);
-        }
-        func->param_types[i] = strdup(param_type);
-        free(param_type);
-        param_type = func->param_types[i];
-      }
-    } else {
-      if (func->param_has_default[i]) {
-        arg_value = interpreter_evaluate(interpreter, func->param_defaults[i]);
-        if (!arg_value) {
-          environment_destroy(func_env);
-          return NULL;
-        }
-        
-        if (!param_type) {
-          param_type = infer_type_from_value(arg_value);
-          if (func->param_types[i]) {
-            free(func->param_types[i]);
-          }
-          func->param_types[i] = strdup(param_type);
-          free(param_type);
-          param_type = func->param_types[i];
-        }
-      } else {
-        error_report(ERROR_RUNTIME, node->pos, "Missing required argument",
-                     "This is an internal error - please report");
-        environment_destroy(func_env);
-        return NULL;
-      }
-    }
+  // The argument count is fixed per call site, so a hit can skip the checks.
+  cache->function = func;
+  cache->globals = interpreter->global_env;
+  cache->version = name->version;
+  return func;
+}
 
-    if (param_type && !is_compatible_type(arg_value, param_type)) {
-      char error_msg[256];
-      snprintf(error_msg, sizeof(error_msg),
-               "Type mismatch for parameter '%s': expected '%s', got '%s'",
-               func->param_names[i], param_type,
-               get_value_type_name(arg_value));
-      error_report(ERROR_TYPE, node->pos, error_msg,
-                   "Check the argument type or function signature");
-      value_destroy(arg_value);
-      environment_destroy(func_env);
-      return NULL;
-    }
+bool interpreter_bind_argument(Function *func, int index, Value arg_value,
+                               Position pos) {
+  const Type *param_type = func->param_types[index];
 
-    environment_define_default(func_env, func->param_names[i], arg_value, param_type);
+  if (!param_type) {
+    param_type = type_of_value(arg_value);
+    func->param_types[index] = param_type;
   }
 
-  Environment *prev_env = interpreter->current_env;
-  interpreter->current_env = func_env;
-  bool prev_return_flag = interpreter->return_flag;
-  Value *prev_return_value = interpreter->return_value;
-
-  interpreter->return_flag = false;
-  interpreter->return_value = NULL;
+  if (!type_accepts(param_type, arg_value)) {
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg),
+             "Type mismatch for parameter '%s': expected '%s', got '%s'",
+             func->param_names[index]->name, param_type->name->name,
+             get_value_type_name(arg_value));
+    error_report(ERROR_TYPE, pos, error_msg,
+                 "Check the argument type or function signature");
+    return false;
+  }
 
-  char *current_func_return_type = func->return_type;
-  bool current_func_is_public = func->is_public;
-  Position func_declaration_pos = func->declaration_pos;
-  interpreter_evaluate(interpreter, func->body);
+  return true;
+}
 
-  Value *result = NULL;
-  if (interpreter->return_flag && interpreter->return_value) {
-    if (current_func_return_type &&
-        !is_compatible_type(interpreter->return_value,
-                            current_func_return_type)) {
+Value interpreter_complete_call(Function *func, Value return_value) {
+  if (!value_is_none(return_value)) {
+    if (!type_accepts(func->return_type, return_value)) {
       char error_msg[256];
       char suggestion[256];
 
       snprintf(error_msg, sizeof(error_msg),
                "Return type mismatch in function '%s': expected '%s', got '%s'",
-               func->name, current_func_return_type,
-               get_value_type_name(interpreter->return_value));
+               func->name, func->return_type->name->name,
+               get_value_type_name(return_value));
 
-      if (current_func_is_public) {
+      if (func->is_public) {
         strcpy(suggestion,
                "Return type does not match the function's requirements");
       } else {
         snprintf(suggestion, sizeof(suggestion),
                  "Convert the return value to '%s' or change the function's "
                  "return type",
-                 current_func_return_type);
+                 func->return_type->name->name);
       }
 
-      error_report(ERROR_TYPE, func_declaration_pos, error_msg, suggestion);
-
-      value_destroy(interpreter->return_value);
-      interpreter->current_env = prev_env;
-      interpreter->return_flag = prev_return_flag;
-      interpreter->return_value = prev_return_value;
-      environment_destroy(func_env);
-      return NULL;
+      error_report(ERROR_TYPE, func->declaration_pos, error_msg, suggestion);
+      value_destroy(return_value);
+      return value_none();
     }
 
-    result = value_copy(interpreter->return_value);
-    value_destroy(interpreter->return_value);
-  } else {
-    if (func->return_type && strcmp(func->return_type, "void") != 0) {
-      char error_msg[256];
-      snprintf(error_msg, sizeof(error_msg),
-               "Function '%s' should return '%s' but no return statement found",
-               func->name, func->return_type);
+    return return_value;
+  }
+
+  if (func->return_type && func->return_type->accepts != VALUE_NULL) {
+    char error_msg[256];
+    snprintf(error_msg, sizeof(error_msg),
+             "Function '%s' should return '%s' but no return statement found",
+             func->name, func->return_type->name->name);
+
+    error_report(ERROR_TYPE, func->declaration_pos, error_msg,
+                 "Add a return statement with the correct type");
+    return value_none();
+  }
+
+  return value_create_null();
+}
 
-      error_report(ERROR_TYPE, func_declaration_pos, error_msg,
-                   "Add a return statement with the correct type");
+static void destroy_arguments(Value *args, int count, Value *inline_args) {
+  for (int i = 0; i < count; i++) {
+    value_destroy(args[i]);
+  }
+  if (args != inline_args) {
+    free(args);
+  }
+}
+
+void interpreter_report_overflow(Interpreter *interpreter, Position pos) {
+  char error_msg[128];
+  snprintf(error_msg, sizeof(error_msg),
+           "Maximum call depth exceeded (%d nested calls)",
+           interpreter->max_call_depth);
+  error_report(ERROR_RUNTIME, pos, error_msg,
+               "Check for recursion that never returns, or raise the limit "
+               "with --max-depth");
+  interpreter->halted = true;
+}
+
+// Native stack the tree walker lets nested calls use: the soft limit less
+// a margin for everything below and above the evaluator.
+static size_t native_stack_budget(void) {
+  size_t limit = 1024 * 1024;
+#ifndef _WIN32
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_STACK, &rl) == 0) {
+    limit = rl.rlim_cur == RLIM_INFINITY ? (size_t)64 * 1024 * 1024
+                                         : (size_t)rl.rlim_cur;
+  }
+#endif
+  size_t margin = limit / 8 > 256 * 1024 ? limit / 8 : 256 * 1024;
+  return limit > 2 * margin ? limit - margin : limit / 2;
+}
+
+// True, after reporting it, if another tree-walked call would go past the
+// depth limit or run the native stack out.
+static bool tree_walk_overflows(Interpreter *interpreter, Position pos) {
+  if (interpreter->call_depth >= interpreter->max_call_depth) {
+    interpreter_report_overflow(interpreter, pos);
+    return true;
+  }
 
-      interpreter->current_env = prev_env;
-      interpreter->return_flag = prev_return_flag;
-      interpreter->return_value = prev_return_value;
-      environment_destroy(func_env);
-      return NULL;
+  char marker;
+  size_t used = interpreter->stack_base > &marker
+                    ? (size_t)(interpreter->stack_base - &marker)
+                    : (size_t)(&marker - interpreter->stack_base);
+  if (used > interpreter->stack_budget) {
+    char error_msg[128];
+    snprintf(error_msg, sizeof(error_msg),
+             "Native stack exhausted after %d nested calls",
+             interpreter->call_depth);
+    error_report(ERROR_RUNTIME, pos, error_msg,
+                 "Check for recursion that never returns, or run without "
+                 "--tree-walk, whose calls do not use the native stack");
+    interpreter->halted = true;
+    return true;
+  }
+  return false;
+}
+
+static Value evaluate_function_call(Interpreter *interpreter, ASTNode *node) {
+  Function *func = interpreter_resolve_callee(
+      interpreter, node->function_call.name, node->function_call.where,
+      node->function_call.argument_count, &node->function_call.cache,
+      node->pos);
+  if (!func)
+    return value_none();
+
+  // Arguments are evaluated in the caller's scope before the callee's scope
+  // exists, so every live scope is on the current chain (as in the VM).
+  int provided_args = node->function_call.argument_count;
+  Value inline_args[CALL_INLINE_ARGS];
+  Value *args = func->param_count <= CALL_INLINE_ARGS
+                    ? inline_args
+                    : malloc(sizeof(Value) * func->param_count);
+
+  for (int i = 0; i < func->param_count; i++) {
+    Value arg_value;
+
+    if (i < provided_args) {
+      arg_value = interpreter_evaluate(interpreter, node->function_call.arguments[i]);
+    } else if (func->param_has_default[i]) {
+      arg_value = interpreter_evaluate(interpreter, func->param_defaults[i]);
+    } else {
+      error_report(ERROR_RUNTIME, node->pos, "Missing required argument",
+                   "This is an internal error - please report");
+      destroy_arguments(args, i, inline_args);
+      return value_none();
+    }
+
+    if (value_is_none(arg_value)) {
+      destroy_arguments(args, i, inline_args);
+      return value_none();
+    }
+
+    if (!interpreter_bind_argument(func, i, arg_value, node->pos)) {
+      value_destroy(arg_value);
+      destroy_arguments(args, i, inline_args);
+      return value_none();
     }
 
-    result = value_create_null();
+    args[i] = arg_value;
+  }
+
+  if (tree_walk_overflows(interpreter, node->pos)) {
+    destroy_arguments(args, func->param_count, inline_args);
+    return value_none();
   }
 
+  Environment *func_env = environment_push(
+      interpreter->scopes, interpreter->current_env, func->param_count);
+  INTERPRETER_COUNT(interpreter, scopes_created);
+  for (int i = 0; i < func->param_count; i++) {
+    environment_define_slot_take(func_env, i, func->param_names[i], &args[i],
+                                 func->param_types[i], false);
+  }
+  destroy_arguments(args, func->param_count, inline_args);
+
+  Environment *prev_env = interpreter->current_env;
+  interpreter->current_env = func_env;
+  bool prev_return_flag = interpreter->return_flag;
+  Value prev_return_value = interpreter->return_value;
+
+  interpreter->return_flag = false;
+  interpreter->return_value = value_none();
+
+  interpreter->call_depth++;
+  interpreter_evaluate(interpreter, func->body);
+  interpreter->call_depth--;
+
+  Value return_value = interpreter->return_value;
+
   interpreter->current_env = prev_env;
   interpreter->return_flag = prev_return_flag;
   interpreter->return_value = prev_return_value;
 
-  environment_destroy(func_env);
-  return result;
+  environment_pop(interpreter->scopes, func_env);
+  if (interpreter->halted) {
+    value_destroy(return_value);
+    return value_none();
+  }
+  return interpreter_complete_call(func, return_value);
 }
 
-static Value *evaluate_format_string(Interpreter *interpreter, ASTNode *node) {
-    char *result = malloc(1024);
-    if (!result) return NULL;
-    
-    result[0] = '\0';
-    
-    const char *template = node->format_string.template;
-    int expr_index = 0;
-    size_t result_len = 0;
-    size_t result_capacity = 1024;
-    
-    for (size_t i = 0; template[i]; i++) {
-        if (template[i] == '$' && template[i + 1] == '{') {
-            // Find the end of the placeholder
-            size_t start = i + 2;
-            size_t end = start;
-            int brace_count = 1;
-            
-            while (template[end] && brace_count > 0) {
-                if (template[end] == '{') brace_count++;
-                else if (template[end] == '}') brace_count--;
-                end++;
-            }
-            
-            if (brace_count == 0 && expr_index < node->format_string.expression_count) {
-                Value *expr_value = interpreter_evaluate(interpreter, 
-                                                       node->format_string.expressions[expr_index]);
-                
-                if (expr_value) {
-                    char *expr_str = value_to_string(expr_value);
-                    size_t expr_len = strlen(expr_str);
-
-                    while (result_len + expr_len >= result_capacity) {
-                        result_capacity *= 2;
-                        result = realloc(result, result_capacity);
-                        if (!result) {
-                            free(expr_str);
-                            value_destroy(expr_value);
-                            return NULL;
-                        }
-                    }
-                    
-                    strcat(result, expr_str);
-                    result_len += expr_len;
-                    
-                    free(expr_str);
-                    value_destroy(expr_value);
-                } else {
-                    printf("LIZARD-INTERPRET-DEBUG: Failed to evaluate expression at index %d\n", expr_index);
-                    
-                    char placeholder[256];
-                    size_t placeholder_len = end - i;
-                    if (placeholder_len < sizeof(placeholder)) {
-                        strncpy(placeholder, template + i, placeholder_len);
-                        placeholder[placeholder_len] = '\0';
-                        
-                        while (result_len + placeholder_len >= result_capacity) {
-                            result_capacity *= 2;
-                            result = realloc(result, result_capacity);
-                            if (!result) return NULL;
-                        }
-                        
-                        strcat(result, placeholder);
-                        result_len += placeholder_len;
-                    }
-                }
-                
-                expr_index++;
-                i = end - 1;
-            } else {
-                if (result_len + 1 >= result_capacity) {
-                    result_capacity *= 2;
-                    result = realloc(result, result_capacity);
-                    if (!result) return NULL;
-                }
-                result[result_len++] = template[i];
-                result[result_len] = '\0';
-            }
+// Small formats keep the text of their values on the stack.
+#define FORMAT_INLINE_VALUES 8
+
+String *interpreter_render_format(const FormatTemplate *format, const Value *values,
+                                  int value_count) {
+    FormatSlice inline_texts[FORMAT_INLINE_VALUES];
+    char inline_buffers[FORMAT_INLINE_VALUES][VALUE_TEXT_SIZE];
+    FormatSlice *texts = inline_texts;
+    char (*buffers)[VALUE_TEXT_SIZE] = inline_buffers;
+
+    if (value_count > FORMAT_INLINE_VALUES) {
+        texts = malloc(sizeof(FormatSlice) * value_count);
+        buffers = malloc(sizeof(*buffers) * value_count);
+        if (!texts || !buffers) {
+            free(texts);
+            free(buffers);
+            return NULL;
+        }
+    }
+
+    // Measure everything first so the result is written in one allocation.
+    // A value that failed to evaluate shows its placeholder as written.
+    size_t total = format->literal_length;
+    for (int i = 0; i < value_count; i++) {
+        if (value_is_none(values[i])) {
+            texts[i] = format->placeholders[i];
         } else {
-            if (result_len + 1 >= result_capacity) {
-                result_capacity *= 2;
-                result = realloc(result, result_capacity);
-                if (!result) return NULL;
-            }
-            result[result_len++] = template[i];
-            result[result_len] = '\0';
+            texts[i].text = value_text(values[i], buffers[i], &texts[i].length);
+        }
+        total += texts[i].length;
+    }
+
+    String *result = string_alloc(total);
+    if (result) {
+        char *out = result->chars;
+        for (int i = 0; i < value_count; i++) {
+            memcpy(out, format->literals[i].text, format->literals[i].length);
+            out += format->literals[i].length;
+            memcpy(out, texts[i].text, texts[i].length);
+            out += texts[i].length;
+        }
+        memcpy(out, format->literals[value_count].text,
+               format->literals[value_count].length);
+    }
+
+    if (texts != inline_texts) {
+        free(texts);
+        free(buffers);
+    }
+    return result;
+}
+
+static Value evaluate_format_string(Interpreter *interpreter, ASTNode *node) {
+    int count = node->format_string.expression_count;
+    Value inline_values[FORMAT_INLINE_VALUES] = {0};
+    Value *values = count > FORMAT_INLINE_VALUES ? malloc(sizeof(Value) * count)
+                                                 : inline_values;
+
+    // Placeholders are filled strictly left to right, so evaluating every
+    // expression up front preserves the order of side effects and errors.
+    for (int i = 0; i < count; i++) {
+        values[i] = interpreter_evaluate(interpreter,
+                                         node->format_string.expressions[i]);
+        if (value_is_none(values[i])) {
+            printf("LIZARD-INTERPRET-DEBUG: Failed to evaluate expression at index %d\n", i);
         }
     }
-    
-    Value *string_value = value_create_string(result);
-    free(result);
-    return string_value;
+
+    String *result = interpreter_render_format(&node->format_string.segments,
+                                               values, count);
+
+    for (int i = 0; i < count; i++) {
+        value_destroy(values[i]);
+    }
+    if (values != inline_values) free(values);
+
+    if (!result) return value_none();
+
+    return value_from_string(result);
 }
 
-Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
+Value interpreter_lookup_variable(Interpreter *interpreter, Symbol *name,
+                                  EnvSlot where, Position pos) {
+  EnvEntry *entry = environment_resolve(interpreter->current_env, name, where);
+  if (!entry || !entry->is_initialized) {
+    error_report(ERROR_RUNTIME, pos, "Undefined variable",
+                 "Check if the variables is has been declared correctly.");
+    return value_none();
+  }
+  return value_copy(entry->value);
+}
+
+bool interpreter_define_variable(Interpreter *interpreter, Symbol *name,
+                                 int slot, const Type *var_type, bool is_fixed,
+                                 Value *value, Position pos) {
+  if (value && !type_accepts(var_type, *value)) {
+    char error_msg[256];
+    const char *value_type = "unknown";
+    switch (value->type) {
+        case VALUE_INT: value_type = "int"; break;
+        case VALUE_FLOAT: value_type = "float"; break;
+        case VALUE_STRING: value_type = "string"; break;
+        case VALUE_BOOL: value_type = "bool"; break;
+        case VALUE_NULL: value_type = "null"; break;
+        default: break;
+    }
+    snprintf(error_msg, sizeof(error_msg),
+             "Type mismatch: Expected '%s', got '%s' for variable '%s'",
+             value_type, var_type ? var_type->name->name : "(null)",
+             name->name);
+
+    error_report(ERROR_RUNTIME, pos, error_msg,
+                 "Make sure the assigned value matches the declared type");
+    return false;
+  }
+
+  bool defined =
+      slot >= 0 ? environment_define_slot_take(interpreter->current_env, slot,
+                                               name, value, var_type, is_fixed)
+                : environment_define_take(interpreter->current_env, name, value,
+                                          var_type, is_fixed);
+  if (!defined) {
+    error_report(ERROR_RUNTIME, pos,
+                 "Variable already declared in this scope",
+                 "Use a different variable name or assign to existing variable");
+    return false;
+  }
+
+  return true;
+}
+
+bool interpreter_assign_variable(Interpreter *interpreter, Symbol *name,
+                                 EnvSlot where, Value *value, Position pos) {
+  EnvEntry *var_entry =
+      environment_resolve(interpreter->current_env, name, where);
+  if (!var_entry) {
+      error_report(ERROR_RUNTIME, pos,
+                   "Variable not declared",
+                   "Declare the variable with 'let' before assignment");
+      return false;
+  }
+
+  if (!type_accepts(var_entry->type, *value)) {
+      char error_msg[256];
+      const char *value_type = "unknown";
+      switch (value->type) {
+          case VALUE_INT: value_type = "int"; break;
+          case VALUE_FLOAT: value_type = "float"; break;
+          case VALUE_STRING: value_type = "string"; break;
+          case VALUE_BOOL: value_type = "bool"; break;
+          case VALUE_NULL: value_type = "null"; break;
+          default: break;
+      }
+      snprintf(error_msg, sizeof(error_msg),
+               "Type mismatch: cannot assign %s to %s variable '%s'",
+               value_type, var_entry->type ? var_entry->type->name->name : "auto",
+               name->name);
+
+      error_report(ERROR_RUNTIME, pos, error_msg,
+                   "Make sure the assigned value matches the declared type");
+      return false;
+  }
+
+  if (!environment_set_entry_take(var_entry, value)) {
+      if (var_entry->is_fixed && var_entry->is_initialized) {
+          error_report(ERROR_RUNTIME, pos,
+                       "Cannot reassign fixed variable",
+                       "Fixed variables can only be assigned once");
+      } else {
+          error_report(ERROR_RUNTIME, pos,
+                       "Unknown assignment error",
+                       "Check variable declaration and scope");
+      }
+      return false;
+  }
+
+  return true;
+}
+
+bool interpreter_declare_function(Interpreter *interpreter, ASTNode *node,
+                                  int slot, Chunk *chunk) {
+  Function *func = function_create(
+    node->function_declaration.name->name,
+    node->function_declaration.param_names,
+    node->function_declaration.param_types,
+    node->function_declaration.param_defaults,
+    node->function_declaration.param_has_default,
+    node->function_declaration.param_count,
+    node->function_declaration.return_type,
+    node->function_declaration.body,
+    node->function_declaration.is_public,
+    node->pos);
+  func->chunk = chunk;
+
+  Value func_value = value_create_function(func);
+  const Type *type = type_of_value(func_value);
+  bool defined;
+  if (slot >= 0) {
+    defined = environment_define_slot_take(interpreter->current_env, slot,
+                                           node->function_declaration.name,
+                                           &func_value, type, false);
+  } else {
+    defined = environment_define_take(interpreter->current_env,
+                                      node->function_declaration.name,
+                                      &func_value, type, false);
+  }
+  // A name already bound in this scope keeps its first function, and the
+  // new one goes with the reference the failed define left behind.
+  value_destroy(func_value);
+  return defined;
+}
+
+Value interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
   if (!node)
-    return NULL;
+    return value_none();
 
   switch (node->type) {
   case AST_PROGRAM:
     for (int i = 0; i < node->program.statement_count; i++) {
-      interpreter_evaluate(interpreter, node->program.statements[i]);
-      if (interpreter->return_flag)
+      value_destroy(interpreter_evaluate(interpreter, node->program.statements[i]));
+      if (interpreter->return_flag || interpreter->halted)
         break;
     }
-    return NULL;
+    return value_none();
 
   case AST_VARIABLE_DECLARATION: {
-    Value *value = NULL;
+    Value value = value_none();
     if (node->variable_declaration.initializer) {
         value = interpreter_evaluate(interpreter, node->variable_declaration.initializer);
-        if (!value) return NULL;
-        
-        if (!is_compatible_type(value, node->variable_declaration.var_type)) {
-            char error_msg[256];
-            const char *value_type = "unknown";
-            switch (value->type) {
-                case VALUE_INT: value_type = "int"; break;
-                case VALUE_FLOAT: value_type = "float"; break;
-                case VALUE_STRING: value_type = "string"; break;
-                case VALUE_BOOL: value_type = "bool"; break;
-                case VALUE_NULL: value_type = "null"; break;
-            }
-            snprintf(error_msg, sizeof(error_msg), 
-                     "Type mismatch: Expected '%s', got '%s' for variable '%s'",
-                     value_type, node->variable_declaration.var_type, 
-                     node->variable_declaration.name);
-            
-            error_report(ERROR_RUNTIME, node->pos, error_msg,
-                         "Make sure the assigned value matches the declared type");
-            value_destroy(value);
-            return NULL;
-        }
+        if (value_is_none(value)) return value_none();
     }
 
-    if (!environment_define(interpreter->current_env,
-                            node->variable_declaration.name, 
-                            value,
-                            node->variable_declaration.var_type,
-                            node->variable_declaration.is_fixed)) {
-        error_report(ERROR_RUNTIME, node->pos, 
-                     "Variable already declared in this scope",
-                     "Use a different variable name or assign to existing variable");
-        if (value) value_destroy(value);
-        return NULL;
+    bool has_value = !value_is_none(value);
+    if (!interpreter_define_variable(interpreter,
+                                     node->variable_declaration.name,
+                                     node->variable_declaration.slot,
+                                     node->variable_declaration.var_type,
+                                     node->variable_declaration.is_fixed,
+                                     has_value ? &value : NULL, node->pos)) {
+        value_destroy(value);
+        return value_none();
     }
 
-    Value *result = value ? value_copy(value) : value_create_null();
-    if (value) value_destroy(value);
-    return result;
-  }
-  
-  case AST_FUNCTION_DECLARATION: {
-    Position return_type_pos = node->pos;
-    if (node->function_declaration.return_type) {
-      return_type_pos.column += strlen(node->function_declaration.name) + 10;
-    }
-    Function *func = function_create(
-      node->function_declaration.name, 
-      node->function_declaration.param_names,
-      node->function_declaration.param_types,
-      node->function_declaration.param_defaults,
-      node->function_declaration.param_has_default,
-      node->function_declaration.param_count,
-      node->function_declaration.return_type, 
-      node->function_declaration.body,
-      node->function_declaration.is_public, 
-      node->pos); 
-
-    Value *func_value = value_create_function(func);
-    environment_define_default(interpreter->current_env,
-                       node->function_declaration.name, func_value, "function");
-    return NULL;
+    return value_create_null();
   }
 
+  case AST_FUNCTION_DECLARATION:
+    interpreter_declare_function(interpreter, node,
+                                 node->function_declaration.slot, NULL);
+    return value_none();
+
   case AST_RETURN_STATEMENT: {
     if (node->return_statement.expression) {
       interpreter->return_value =
@@ -576,7 +843,7 @@ Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
       interpreter->return_value = value_create_null();
     }
     interpreter->return_flag = true;
-    return NULL;
+    return value_none();
   }
 
   case AST_EXPRESSION_STATEMENT:
@@ -584,32 +851,41 @@ Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
                                 node->expression_statement.expression);
 
   case AST_BLOCK_STATEMENT: {
-    Environment *block_env = environment_create(interpreter->current_env);
     Environment *prev_env = interpreter->current_env;
-    interpreter->current_env = block_env;
+    if (node->block_statement.needs_scope) {
+      interpreter->current_env =
+          environment_push(interpreter->scopes, prev_env,
+                           node->block_statement.scope_size);
+      INTERPRETER_COUNT(interpreter, scopes_created);
+    } else {
+      INTERPRETER_COUNT(interpreter, scopes_elided);
+    }
 
     for (int i = 0; i < node->block_statement.statement_count; i++) {
-      interpreter_evaluate(interpreter, node->block_statement.statements[i]);
-      if (interpreter->return_flag)
+      value_destroy(interpreter_evaluate(interpreter,
+                                         node->block_statement.statements[i]));
+      if (interpreter->return_flag || interpreter->halted)
         break;
     }
 
+    if (node->block_statement.needs_scope) {
+      environment_pop(interpreter->scopes, interpreter->current_env);
+    }
     interpreter->current_env = prev_env;
-    environment_destroy(block_env);
-    return NULL;
+    return value_none();
   }
 
   case AST_PRINT_STATEMENT: {
-    Value *value =
+    Value value =
         interpreter_evaluate(interpreter, node->print_statement.expression);
-    if (value) {
+    if (!value_is_none(value)) {
       value_print(value);
       if (node->print_statement.newline) {
         printf("\n");
       }
       value_destroy(value);
     }
-    return NULL;
+    return value_none();
   }
 
   case AST_FUNCTION_CALL:
@@ -621,16 +897,9 @@ Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
   case AST_UNARY_EXPRESSION:
     return evaluate_unary_expression(interpreter, node);
 
-  case AST_IDENTIFIER: {
-    Value *value =
-        environment_get(interpreter->current_env, node->identifier.name);
-    if (!value) {
-      error_report(ERROR_RUNTIME, node->pos, "Undefined variable",
-                   "Check if the variables is has been declared correctly.");
-      return NULL;
-    }
-    return value_copy(value);
-  }
+  case AST_IDENTIFIER:
+    return interpreter_lookup_variable(interpreter, node->identifier.name,
+                                       node->identifier.where, node->pos);
 
   case AST_LITERAL:
     return value_copy(node->literal.value);
@@ -639,68 +908,77 @@ Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node) {
     return evaluate_format_string(interpreter, node);
 
   case AST_ASSIGNMENT_EXPRESSION: {
-    Value *value = interpreter_evaluate(interpreter, node->assignment_expression.value);
-    if (!value) return NULL;
-
-    EnvEntry *var_entry = environment_get_entry(interpreter->current_env, node->assignment_expression.name);
-    if (!var_entry) {
-        error_report(ERROR_RUNTIME, node->pos, 
-                     "Variable not declared",
-                     "Declare the variable with 'let' before assignment");
-        value_destroy(value);
-        return NULL;
-    }
-    
-    if (!is_compatible_type(value, var_entry->type)) {
-        char error_msg[256];
-        const char *value_type = "unknown";
-        switch (value->type) {
-            case VALUE_INT: value_type = "int"; break;
-            case VALUE_FLOAT: value_type = "float"; break;
-            case VALUE_STRING: value_type = "string"; break;
-            case VALUE_BOOL: value_type = "bool"; break;
-            case VALUE_NULL: value_type = "null"; break;
-        }
-        snprintf(error_msg, sizeof(error_msg), 
-                 "Type mismatch: cannot assign %s to %s variable '%s'",
-                 value_type, var_entry->type ? var_entry->type : "auto", 
-                 node->assignment_expression.name);
-        
-        error_report(ERROR_RUNTIME, node->pos, error_msg,
-                     "Make sure the assigned value matches the declared type");
-        value_destroy(value);
-        return NULL;
-    }
+    Value value = interpreter_evaluate(interpreter, node->assignment_expression.value);
+    if (value_is_none(value)) return value_none();
 
-    if (!environment_set(interpreter->current_env, node->assignment_expression.name, value)) {
-        if (var_entry->is_fixed && var_entry->is_initialized) {
-            error_report(ERROR_RUNTIME, node->pos, 
-                         "Cannot reassign fixed variable",
-                         "Fixed variables can only be assigned once");
-        } else {
-            error_report(ERROR_RUNTIME, node->pos, 
-                         "Unknown assignment error",
-                         "Check variable declaration and scope");
-        }
+    if (!interpreter_assign_variable(interpreter,
+                                     node->assignment_expression.name,
+                                     node->assignment_expression.where, &value,
+                                     node->pos)) {
         value_destroy(value);
-        return NULL;
+        return value_none();
     }
 
-    Value *result = value_copy(value);
-    value_destroy(value);
-    return result;
+    return value_create_null();
   }
   case AST_IMPORT_STATEMENT:
     // Import handling should be done before interpretation
-    return NULL;
+    return value_none();
 
   default:
     error_report(ERROR_RUNTIME, node->pos, "Unknown AST node type",
                  "This might be a compiler bug");
-    return NULL;
+    return value_none();
   }
 }
 
 void interpreter_run(Interpreter *interpreter, ASTNode *ast) {
-  interpreter_evaluate(interpreter, ast);
-}
\ No newline at end of file
+  interpreter->halted = false;
+  if (interpreter->tree_walk) {
+    char base;
+    interpreter->stack_base = &base;
+    interpreter->stack_budget = native_stack_budget();
+    interpreter->call_depth = 0;
+    interpreter_evaluate(interpreter, ast);
+    interpreter->stack_base = NULL;
+    return;
+  }
+
+  if (!interpreter->vm) {
+    interpreter->vm = vm_create(interpreter);
+  }
+  vm_run_program(interpreter->vm, ast);
+}
+
+void interpreter_stats_add(InterpreterStats *into,
+                           const InterpreterStats *from) {
+  into->scopes_created += from->scopes_created;
+  into->scopes_elided += from->scopes_elided;
+  into->call_cache_hits += from->call_cache_hits;
+  into->call_cache_misses += from->call_cache_misses;
+  into->binary_fast += from->binary_fast;
+  into->binary_despecialized += from->binary_despecialized;
+  into->quickened += from->quickened;
+  into->deopts += from->deopts;
+  for (int op = 0; op < OP_COUNT; op++)
+    into->quick_runs[op] += from->quick_runs[op];
+}
+
+void interpreter_print_stats(const Interpreter *interpreter) {
+  const InterpreterStats *stats = &interpreter->stats;
+  fprintf(stderr, "-- stats --\n");
+  fprintf(stderr, "scopes created:  %lu\n", stats->scopes_created);
+  fprintf(stderr, "scopes elided:   %lu\n", stats->scopes_elided);
+  fprintf(stderr, "call cache hits: %lu\n", stats->call_cache_hits);
+  fprintf(stderr, "call cache miss: %lu\n", stats->call_cache_misses);
+  fprintf(stderr, "binary fast:     %lu\n", stats->binary_fast);
+  fprintf(stderr, "binary despec:   %lu\n", stats->binary_despecialized);
+  fprintf(stderr, "quickened:       %lu\n", stats->quickened);
+  fprintf(stderr, "deopts:          %lu\n", stats->deopts);
+  for (int op = 0; op < OP_COUNT; op++) {
+    if (stats->quick_runs[op]) {
+      fprintf(stderr, "  %-20s %lu\n", opcode_name((OpCode)op),
+              stats->quick_runs[op]);
+    }
+  }
+}
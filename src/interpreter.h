@@ -4,18 +4,93 @@
 #include "parser.h"
 #include "environment.h"
 #include "value.h"
+#include "bytecode.h"
+
+struct VM;
+
+// Nested Lizard calls allowed unless --max-depth says otherwise. The VM keeps
+// its frames on the heap, so the limit only guards against runaway memory
+// use; the tree walker also stops before it would exhaust the native stack.
+#define CALL_DEPTH_DEFAULT 100000
+
+// Execution counters, printed by --stats.
+typedef struct {
+    unsigned long scopes_created;  // Function and block scopes entered
+    unsigned long scopes_elided;   // Blocks run in their enclosing scope instead
+    unsigned long call_cache_hits; // Calls that reused their site's last callee
+    unsigned long call_cache_misses;
+    unsigned long binary_fast;     // Arithmetic done on a specialized AST path
+    unsigned long binary_despecialized; // Sites whose type guard failed
+    unsigned long quickened;       // Bytecode instructions rewritten by the VM
+    unsigned long deopts;          // Quickened instructions whose guard failed
+    unsigned long quick_runs[OP_COUNT]; // Runs of each quickened opcode
+} InterpreterStats;
+
+// Bumps a counter only when --stats asked for them, so that hot paths do
+// not pay for a store nobody reads.
+#define INTERPRETER_COUNT(interpreter, counter)                             \
+    do {                                                                    \
+        if ((interpreter)->collect_stats)                                   \
+            (interpreter)->stats.counter++;                                 \
+    } while (0)
+
+// Adds every counter in `from` to `into`, e.g. an imported module's run.
+void interpreter_stats_add(InterpreterStats *into, const InterpreterStats *from);
 
 typedef struct {
     Environment *global_env;
     Environment *current_env;
+    ScopeStack *scopes;  // Function and block scopes, released in LIFO order
     bool return_flag;
-    Value *return_value;
+    Value return_value;  // VALUE_NONE until a return statement runs
     Function *current_function;
+    bool tree_walk;      // Evaluate the AST directly instead of compiling to bytecode
+    struct VM *vm;
+    bool collect_stats;  // Fill in stats, including events only instrumented code observes
+    int optimize_level;  // -O level, applied to imported modules as they load
+    int max_call_depth;  // Nested calls allowed before a stack overflow error
+    int call_depth;      // Tree walker: calls currently being evaluated
+    bool halted;         // A stack overflow stopped the program; run nothing more
+    char *stack_base;    // Tree walker: native stack pointer when the run began
+    size_t stack_budget; // Tree walker: native stack bytes calls may use
+    InterpreterStats stats;
 } Interpreter;
 
 Interpreter *interpreter_create(void);
 void interpreter_destroy(Interpreter *interpreter);
-Value *interpreter_evaluate(Interpreter *interpreter, ASTNode *node);
+Value interpreter_evaluate(Interpreter *interpreter, ASTNode *node);
 void interpreter_run(Interpreter *interpreter, ASTNode *ast);
+void interpreter_print_stats(const Interpreter *interpreter);
+
+// Language semantics shared by the tree walker and the bytecode VM.
+// Each helper reports its own errors and returns VALUE_NONE/false on failure.
+// Operands are borrowed; returned values are owned by the caller.
+Value interpreter_binary_operation(TokenType operator, Value left, Value right,
+                                   Position pos);
+Value interpreter_unary_operation(TokenType operator, Value operand,
+                                  Position pos);
+Value interpreter_lookup_variable(Interpreter *interpreter, Symbol *name,
+                                  EnvSlot where, Position pos);
+// Both move `*value` into the variable, leaving none behind on success; on
+// failure the caller still owns it.
+bool interpreter_define_variable(Interpreter *interpreter, Symbol *name,
+                                 int slot, const Type *var_type, bool is_fixed,
+                                 Value *value, Position pos);
+bool interpreter_assign_variable(Interpreter *interpreter, Symbol *name,
+                                 EnvSlot where, Value *value, Position pos);
+// Binds a new function, running `chunk` under the VM (NULL when tree
+// walking). Returns false, keeping the existing binding, if the name was
+// already declared in the current scope.
+bool interpreter_declare_function(Interpreter *interpreter, ASTNode *node,
+                                  int slot, Chunk *chunk);
+Function *interpreter_resolve_callee(Interpreter *interpreter, Symbol *name,
+                                     EnvSlot where, int provided_args,
+                                     CallCache *cache, Position pos);
+bool interpreter_bind_argument(Function *func, int index, Value arg_value,
+                               Position pos);
+Value interpreter_complete_call(Function *func, Value return_value);
+void interpreter_report_overflow(Interpreter *interpreter, Position pos);
+String *interpreter_render_format(const FormatTemplate *format, const Value *values,
+                                  int value_count);
 
-#endif
\ No newline at end of file
+#endif
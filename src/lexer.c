@@ -1,40 +1,51 @@
 #include "lexer.h"
 #include "error.h"
+#include "source.h"
+#include "scan.h"
+#include <stdint.h>
 
-Lexer *lexer_create(const char *source, const char *filename) {
+static void keyword_table_init(void);
+
+Lexer *lexer_create(const char *source, size_t length, const char *filename) {
+    keyword_table_init();
+    
+    if (length > SOURCE_MAX_LENGTH) {
+        error_report(ERROR_LEXER, position_for_file(filename),
+                    "Source file is too large", "Split it into modules of under 4 GB");
+        return NULL;
+    }
+    
+    Lexer *lexer = malloc(sizeof(Lexer));
+    lexer->source = source;
+    lexer->pos = 0;
+    lexer->length = length;
+    lexer->file = source_file_register(filename);
+    lexer->lines = source_file_lines(lexer->file);
+    memset(&lexer->nested_lines, 0, sizeof(LineTable));
+    return lexer;
+}
+
+Lexer *lexer_create_nested(const Lexer *parent) {
     Lexer *lexer = malloc(sizeof(Lexer));
-    lexer->source = strdup(source);
+    lexer->source = parent->source;
     lexer->pos = 0;
-    lexer->length = strlen(source);
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->filename = strdup(filename);
-    lexer->tokens = malloc(sizeof(Token) * 100);
-    lexer->token_count = 0;
-    lexer->token_capacity = 100;
+    lexer->length = 0;
+    lexer->file = parent->file;
+    memset(&lexer->nested_lines, 0, sizeof(LineTable));
+    lexer->lines = &lexer->nested_lines;
     return lexer;
 }
 
 void lexer_destroy(Lexer *lexer) {
     if (!lexer) return;
     
-    free(lexer->source);
-    free(lexer->filename);
-    
-    for (size_t i = 0; i < lexer->token_count; i++) {
-        free(lexer->tokens[i].value);
-        free(lexer->tokens[i].pos.filename);
-    }
-    free(lexer->tokens);
+    free(lexer->nested_lines.starts);
     free(lexer);
 }
 
-Position position_create(int line, int column, char *filename) {
-    Position pos;
-    pos.line = line;
-    pos.column = column;
-    pos.filename = strdup(filename);
-    return pos;
+void lexer_set_range(Lexer *lexer, size_t start, size_t end) {
+    lexer->pos = start;
+    lexer->length = end;
 }
 
 static char lexer_current_char(Lexer *lexer) {
@@ -47,82 +58,86 @@ static char lexer_peek_char(Lexer *lexer) {
     return lexer->source[lexer->pos + 1];
 }
 
+// Positions are plain offsets. Line and column come from the file's line
+// table, which the lexer fills in as it passes each newline, and are only
+// worked out when a position is reported.
+static Position lexer_position(Lexer *lexer) {
+    return position_create(lexer->file, lexer->pos);
+}
+
 static void lexer_advance(Lexer *lexer) {
     if (lexer->pos < lexer->length) {
         if (lexer->source[lexer->pos] == '\n') {
-            lexer->line++;
-            lexer->column = 1;
-        } else {
-            lexer->column++;
+            line_table_add(lexer->lines, lexer->pos + 1);
         }
         lexer->pos++;
     }
 }
 
 static void lexer_skip_whitespace(Lexer *lexer) {
-    while (isspace(lexer_current_char(lexer))) {
-        lexer_advance(lexer);
-    }
+    lexer->pos = scan_skip_whitespace(lexer->source, lexer->pos, lexer->length, lexer->lines);
 }
 
-static void lexer_add_token(Lexer *lexer, TokenType type, const char *value) {
-    if (lexer->token_count >= lexer->token_capacity) {
-        lexer->token_capacity *= 2;
-        lexer->tokens = realloc(lexer->tokens, sizeof(Token) * lexer->token_capacity);
-    }
-    
-    Token *token = &lexer->tokens[lexer->token_count++];
-    token->type = type;
-    token->value = strdup(value);
-    token->pos = position_create(lexer->line, lexer->column, lexer->filename);
+static Token lexer_make_token(Lexer *lexer, TokenType type, size_t start, size_t length) {
+    Token token;
+    token.type = type;
+    token.start = lexer->source + start;
+    token.length = length;
+    token.pos = lexer_position(lexer);
+    return token;
 }
 
-static char *lexer_read_string(Lexer *lexer) {
+// Leaves `start` and `length` spanning the text between the quotes.
+// Escapes are only skipped here; token_string_value decodes them.
+static bool lexer_read_string(Lexer *lexer, size_t *start, size_t *length) {
     char quote = lexer_current_char(lexer);
     lexer_advance(lexer); // Skip opening quote
+    *start = lexer->pos;
     
-    char *buffer = malloc(256);
-    size_t capacity = 256;
-    size_t length = 0;
-    
-    while (lexer_current_char(lexer) != quote && lexer_current_char(lexer) != '\0') {
-        if (length >= capacity - 1) {
-            capacity *= 2;
-            buffer = realloc(buffer, capacity);
-        }
+    for (;;) {
+        lexer->pos = scan_find_quote(lexer->source, lexer->pos, lexer->length, quote,
+                                     lexer->lines);
+        if (lexer_current_char(lexer) != '\\') break;
         
-        if (lexer_current_char(lexer) == '\\') {
-            lexer_advance(lexer);
-            switch (lexer_current_char(lexer)) {
-                case 'n': buffer[length++] = '\n'; break;
-                case 't': buffer[length++] = '\t'; break;
-                case 'r': buffer[length++] = '\r'; break;
-                case '\\': buffer[length++] = '\\'; break;
-                case '"': buffer[length++] = '"'; break;
-                case '\'': buffer[length++] = '\''; break;
-                default: buffer[length++] = lexer_current_char(lexer); break;
-            }
-        } else {
-            buffer[length++] = lexer_current_char(lexer);
-        }
-        lexer_advance(lexer);
+        lexer_advance(lexer); // Backslash
+        if (lexer_current_char(lexer) == '\0') break;
+        lexer_advance(lexer); // Escaped character
     }
     
     if (lexer_current_char(lexer) != quote) {
-        error_report(ERROR_LEXER, position_create(lexer->line, lexer->column, lexer->filename),
+        error_report(ERROR_LEXER, lexer_position(lexer),
                     "Unterminated string literal", "Add closing quote");
-        free(buffer);
-        return NULL;
+        return false;
     }
     
+    *length = lexer->pos - *start;
     lexer_advance(lexer); // Skip closing quote
+    return true;
+}
+
+char *token_string_value(const Token *token) {
+    char *buffer = malloc(token->length + 1);
+    size_t length = 0;
+    
+    for (size_t i = 0; i < token->length; i++) {
+        char c = token->start[i];
+        if (c == '\\' && i + 1 < token->length) {
+            switch (token->start[++i]) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                default: c = token->start[i]; break;
+            }
+        }
+        buffer[length++] = c;
+    }
+    
     buffer[length] = '\0';
     return buffer;
 }
 
-static char *lexer_read_number(Lexer *lexer) {
-    char *buffer = malloc(64);
-    size_t length = 0;
+// Digits may be grouped with '_'; the parser drops the separators.
+static void lexer_read_number(Lexer *lexer) {
     bool has_dot = false;
     
     while (isdigit(lexer_current_char(lexer)) || 
@@ -130,44 +145,89 @@ static char *lexer_read_number(Lexer *lexer) {
            (lexer_current_char(lexer) == '.' && !has_dot)) {
         if (lexer_current_char(lexer) == '.') {
             has_dot = true;
-            buffer[length++] = lexer_current_char(lexer);
-        } else if (lexer_current_char(lexer) == '_') {
-        } else {
-            buffer[length++] = lexer_current_char(lexer);
         }
         lexer_advance(lexer);
     }
-    
-    buffer[length] = '\0';
-    return buffer;
 }
 
-static char *lexer_read_identifier(Lexer *lexer) {
-    char *buffer = malloc(128);
-    size_t length = 0;
-    
+static void lexer_read_identifier(Lexer *lexer) {
     while (isalnum(lexer_current_char(lexer)) || lexer_current_char(lexer) == '_') {
-        buffer[length++] = lexer_current_char(lexer);
         lexer_advance(lexer);
     }
-    
-    buffer[length] = '\0';
-    return buffer;
 }
 
-static TokenType lexer_keyword_or_identifier(const char *text) {
-    if (strcmp(text, "let") == 0) return TOKEN_KEYWORD_LET;
-    if (strcmp(text, "fixed") == 0) return TOKEN_KEYWORD_FIXED; 
-    if (strcmp(text, "fnc") == 0) return TOKEN_KEYWORD_FNC;
-    if (strcmp(text, "return") == 0) return TOKEN_KEYWORD_RETURN;
-    if (strcmp(text, "pub") == 0) return TOKEN_KEYWORD_PUB;
-    if (strcmp(text, "import") == 0) return TOKEN_KEYWORD_IMPORT;
-    if (strcmp(text, "as") == 0) return TOKEN_KEYWORD_AS;
-    if (strcmp(text, "print") == 0) return TOKEN_PRINT;
-    if (strcmp(text, "println") == 0) return TOKEN_PRINTLN;
-    if (strcmp(text, "int") == 0) return TOKEN_IDENTIFIER;
-    if (strcmp(text, "string") == 0) return TOKEN_IDENTIFIER;
-    if (strcmp(text, "float") == 0) return TOKEN_IDENTIFIER;
+// Keywords are found with a perfect hash over the length and the first,
+// second and last characters, so classifying an identifier costs one
+// multiply and at most one memcmp. KEYWORD_SEED is the smallest odd
+// multiplier that gives every keyword a slot of its own. The table is
+// filled from it when the first lexer is created, and that check refuses
+// to start if the keyword list ever changes so that two keywords collide.
+#define KEYWORD_SLOT_BITS 6
+#define KEYWORD_SLOTS (1u << KEYWORD_SLOT_BITS)
+#define KEYWORD_SEED 107u
+
+typedef struct {
+    const char *text;       // NULL for an empty slot
+    size_t length;
+    TokenType type;
+} KeywordSlot;
+
+static const struct {
+    const char *text;
+    TokenType type;
+} keywords[] = {
+#define KEYWORD_ENTRY(type, name, keyword) {keyword, type},
+    TOKEN_TYPES(KEYWORD_ENTRY)
+#undef KEYWORD_ENTRY
+};
+
+static KeywordSlot keyword_slots[KEYWORD_SLOTS];
+static bool keyword_table_ready;
+static size_t keyword_min_length = SIZE_MAX;
+static size_t keyword_max_length;
+
+static uint32_t keyword_hash(const char *text, size_t length) {
+    uint32_t key = ((uint32_t)length << 24) ^
+                   ((uint32_t)(unsigned char)text[0] << 16) ^
+                   ((uint32_t)(unsigned char)text[length > 1] << 8) ^
+                   (uint32_t)(unsigned char)text[length - 1];
+    return (key * KEYWORD_SEED) >> (32 - KEYWORD_SLOT_BITS);
+}
+
+static void keyword_table_init(void) {
+    if (keyword_table_ready) return;
+
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (!keywords[i].text) continue;
+
+        size_t length = strlen(keywords[i].text);
+        if (length < keyword_min_length) keyword_min_length = length;
+        if (length > keyword_max_length) keyword_max_length = length;
+
+        KeywordSlot *slot = &keyword_slots[keyword_hash(keywords[i].text, length)];
+        if (slot->text) {
+            // A new keyword needs a new seed: the smallest odd multiplier
+            // under which no two keywords share a slot.
+            fprintf(stderr, "Fatal: keywords '%s' and '%s' collide under KEYWORD_SEED\n",
+                    slot->text, keywords[i].text);
+            abort();
+        }
+        slot->text = keywords[i].text;
+        slot->length = length;
+        slot->type = keywords[i].type;
+    }
+    keyword_table_ready = true;
+}
+
+static TokenType lexer_keyword_or_identifier(const char *text, size_t length) {
+    if (length < keyword_min_length || length > keyword_max_length) {
+        return TOKEN_IDENTIFIER;
+    }
+
+    const KeywordSlot *slot = &keyword_slots[keyword_hash(text, length)];
+    if (slot->length == length && memcmp(slot->text, text, length) == 0) {
+        return slot->type;
+    }
     return TOKEN_IDENTIFIER;
 }
 
@@ -176,31 +236,29 @@ static void lexer_skip_comment(Lexer *lexer) {
         if (lexer_peek_char(lexer) == '#' && lexer->pos + 2 < lexer->length && 
             lexer->source[lexer->pos + 2] == '#') {
             // Multiline comment ###...###
-            lexer_advance(lexer); // #
-            lexer_advance(lexer); // #
-            lexer_advance(lexer); // #
+            lexer->pos += 3;
             
-            while (lexer->pos + 2 < lexer->length) {
-                if (lexer_current_char(lexer) == '#' && 
-                    lexer_peek_char(lexer) == '#' && 
-                    lexer->source[lexer->pos + 2] == '#') {
-                    lexer_advance(lexer); // #
-                    lexer_advance(lexer); // #
-                    lexer_advance(lexer); // #
+            // An unterminated comment stops two bytes short of the end,
+            // where no closing ### could start.
+            size_t limit = lexer->length - 2;
+            while (lexer->pos < limit) {
+                lexer->pos = scan_find_hash(lexer->source, lexer->pos, limit, lexer->lines);
+                if (lexer->pos >= limit) break;
+                
+                if (lexer_peek_char(lexer) == '#' && lexer->source[lexer->pos + 2] == '#') {
+                    lexer->pos += 3;
                     break;
                 }
-                lexer_advance(lexer);
+                lexer->pos++;
             }
         } else {
             // Single line comment
-            while (lexer_current_char(lexer) != '\n' && lexer_current_char(lexer) != '\0') {
-                lexer_advance(lexer);
-            }
+            lexer->pos = scan_find_newline(lexer->source, lexer->pos, lexer->length);
         }
     }
 }
 
-Token *lexer_tokenize(Lexer *lexer) {
+Token lexer_next_token(Lexer *lexer) {
     while (lexer->pos < lexer->length) {
         lexer_skip_whitespace(lexer);
         
@@ -215,150 +273,95 @@ Token *lexer_tokenize(Lexer *lexer) {
         
         // String literals
         if (current == '"' || current == '\'') {
-            char *str = lexer_read_string(lexer);
-            if (str) {
-                lexer_add_token(lexer, TOKEN_STRING, str);
-                free(str);
+            size_t start, length;
+            if (lexer_read_string(lexer, &start, &length)) {
+                return lexer_make_token(lexer, TOKEN_STRING, start, length);
             }
             continue;
         }
         
+        size_t start = lexer->pos;
+        
         // Numbers
         if (isdigit(current)) {
-            char *num = lexer_read_number(lexer);
-            lexer_add_token(lexer, TOKEN_NUMBER, num);
-            free(num);
-            continue;
+            lexer_read_number(lexer);
+            return lexer_make_token(lexer, TOKEN_NUMBER, start, lexer->pos - start);
         }
         
         // Identifiers and keywords
         if (isalpha(current) || current == '_') {
-            char *ident = lexer_read_identifier(lexer);
-            TokenType type = lexer_keyword_or_identifier(ident);
-            lexer_add_token(lexer, type, ident);
-            free(ident);
-            continue;
+            lexer_read_identifier(lexer);
+            size_t length = lexer->pos - start;
+            TokenType type = lexer_keyword_or_identifier(lexer->source + start, length);
+            return lexer_make_token(lexer, type, start, length);
         }
         
         // Two-character operators
         if (current == '-' && lexer_peek_char(lexer) == '>') {
             lexer_advance(lexer);
             lexer_advance(lexer);
-            lexer_add_token(lexer, TOKEN_ARROW, "->");
-            continue;
+            return lexer_make_token(lexer, TOKEN_ARROW, start, 2);
         }
         
         if (current == '$' && lexer_peek_char(lexer) == '{') {
             lexer_advance(lexer);
             lexer_advance(lexer);
-            lexer_add_token(lexer, TOKEN_DOLLAR_LBRACE, "${");
-            continue;
+            return lexer_make_token(lexer, TOKEN_DOLLAR_LBRACE, start, 2);
         }
         
         if (current == '%' && lexer_peek_char(lexer) == '%') {
             lexer_advance(lexer);
             lexer_advance(lexer);
-            lexer_add_token(lexer, TOKEN_INT_DIVIDE, "%%");
-            continue;
+            return lexer_make_token(lexer, TOKEN_INT_DIVIDE, start, 2);
         }
         
         // Single-character tokens
+        TokenType type;
         switch (current) {
-            case ':': lexer_add_token(lexer, TOKEN_COLON, ":"); break;
-            case ';': lexer_add_token(lexer, TOKEN_SEMICOLON, ";"); break;
-            case ',': lexer_add_token(lexer, TOKEN_COMMA, ","); break;
-            case '.': lexer_add_token(lexer, TOKEN_DOT, "."); break;
-            case '=': lexer_add_token(lexer, TOKEN_ASSIGN, "="); break;
-            case '+': lexer_add_token(lexer, TOKEN_PLUS, "+"); break;
-            case '-': lexer_add_token(lexer, TOKEN_MINUS, "-"); break;
-            case '*': lexer_add_token(lexer, TOKEN_MULTIPLY, "*"); break;
-            case '/': lexer_add_token(lexer, TOKEN_DIVIDE, "/"); break;
-            case '%': lexer_add_token(lexer, TOKEN_MODULO, "%"); break;
-            case '(': lexer_add_token(lexer, TOKEN_LPAREN, "("); break;
-            case ')': lexer_add_token(lexer, TOKEN_RPAREN, ")"); break;
-            case '{': lexer_add_token(lexer, TOKEN_LBRACE, "{"); break;
-            case '}': lexer_add_token(lexer, TOKEN_RBRACE, "}"); break;
-            case '[': lexer_add_token(lexer, TOKEN_LBRACKET, "["); break;
-            case ']': lexer_add_token(lexer, TOKEN_RBRACKET, "]"); break;
+            case ':': type = TOKEN_COLON; break;
+            case ';': type = TOKEN_SEMICOLON; break;
+            case ',': type = TOKEN_COMMA; break;
+            case '.': type = TOKEN_DOT; break;
+            case '=': type = TOKEN_ASSIGN; break;
+            case '+': type = TOKEN_PLUS; break;
+            case '-': type = TOKEN_MINUS; break;
+            case '*': type = TOKEN_MULTIPLY; break;
+            case '/': type = TOKEN_DIVIDE; break;
+            case '%': type = TOKEN_MODULO; break;
+            case '(': type = TOKEN_LPAREN; break;
+            case ')': type = TOKEN_RPAREN; break;
+            case '{': type = TOKEN_LBRACE; break;
+            case '}': type = TOKEN_RBRACE; break;
+            case '[': type = TOKEN_LBRACKET; break;
+            case ']': type = TOKEN_RBRACKET; break;
             default:
-                error_report(ERROR_LEXER, position_create(lexer->line, lexer->column, lexer->filename),
+                error_report(ERROR_LEXER, lexer_position(lexer),
                            "Unexpected character", "Remove or escape this character");
                 lexer_advance(lexer);
                 continue;
         }
+        // Single-character tokens are positioned on the character itself.
+        Token token = lexer_make_token(lexer, type, start, 1);
         lexer_advance(lexer);
+        return token;
     }
     
-    if (lexer->token_count == 0 || 
-        lexer->tokens[lexer->token_count - 1].type != TOKEN_EOF) {
-        
-        Token eof_token = {
-            .type = TOKEN_EOF,
-            .value = NULL,
-            .pos = {
-                .line = lexer->line,
-                .column = lexer->column,
-                .filename = lexer->filename ? strdup(lexer->filename) : NULL
-            }
-        };
-        
-        if (lexer->token_count >= lexer->token_capacity) {
-            lexer->token_capacity *= 2;
-            lexer->tokens = realloc(lexer->tokens, 
-                                  sizeof(Token) * lexer->token_capacity);
-        }
-        
-        lexer->tokens[lexer->token_count++] = eof_token;
-    }
-    
-    lexer_add_token(lexer, TOKEN_EOF, "");
-    return lexer->tokens;
+    return lexer_make_token(lexer, TOKEN_EOF, lexer->length, 0);
 }
 
 const char *token_type_to_string(TokenType type) {
-    switch (type) {
-        case TOKEN_EOF: return "EOF";
-        case TOKEN_IDENTIFIER: return "IDENTIFIER";
-        case TOKEN_STRING: return "STRING";
-        case TOKEN_NUMBER: return "NUMBER";
-        case TOKEN_KEYWORD_LET: return "LET";
-        case TOKEN_KEYWORD_FIXED: return "FIXED";
-        case TOKEN_KEYWORD_FNC: return "FNC";
-        case TOKEN_KEYWORD_RETURN: return "RETURN";
-        case TOKEN_KEYWORD_PUB: return "PUB";
-        case TOKEN_KEYWORD_IMPORT: return "IMPORT";
-        case TOKEN_KEYWORD_AS: return "AS";
-        case TOKEN_PRINT: return "PRINT";
-        case TOKEN_PRINTLN: return "PRINTLN";
-        case TOKEN_COLON: return "COLON";
-        case TOKEN_SEMICOLON: return "SEMICOLON";
-        case TOKEN_COMMA: return "COMMA";
-        case TOKEN_DOT: return "DOT";
-        case TOKEN_ARROW: return "ARROW";
-        case TOKEN_ASSIGN: return "ASSIGN";
-        case TOKEN_PLUS: return "PLUS";
-        case TOKEN_MINUS: return "MINUS";
-        case TOKEN_MULTIPLY: return "MULTIPLY";
-        case TOKEN_DIVIDE: return "DIVIDE";
-        case TOKEN_MODULO: return "MODULO";         
-        case TOKEN_INT_DIVIDE: return "INT_DIVIDE";
-        case TOKEN_LPAREN: return "LPAREN";
-        case TOKEN_RPAREN: return "RPAREN";
-        case TOKEN_LBRACE: return "LBRACE";
-        case TOKEN_RBRACE: return "RBRACE";
-        case TOKEN_LBRACKET: return "LBRACKET";
-        case TOKEN_RBRACKET: return "RBRACKET";
-        case TOKEN_COMMENT: return "COMMENT";
-        case TOKEN_MULTILINE_COMMENT: return "MULTILINE_COMMENT";
-        case TOKEN_FORMAT_STRING: return "FORMAT_STRING";
-        case TOKEN_DOLLAR_LBRACE: return "DOLLAR_LBRACE";
-        case TOKEN_ERROR: return "ERROR";
-        default: return "UNKNOWN";
-    }
+    static const char *const names[] = {
+#define TOKEN_TYPE_NAME(type, name, keyword) name,
+        TOKEN_TYPES(TOKEN_TYPE_NAME)
+#undef TOKEN_TYPE_NAME
+    };
+    
+    if ((size_t)type >= sizeof(names) / sizeof(names[0])) return "UNKNOWN";
+    return names[type];
 }
 
 void token_print(Token *token) {
-    printf("Token: %s, Value: '%s', Line: %d, Column: %d\n",
-           token_type_to_string(token->type), token->value, 
-           token->pos.line, token->pos.column);
+    printf("Token: %s, Value: '%.*s', Line: %d, Column: %d\n",
+           token_type_to_string(token->type), (int)token->length, token->start,
+           position_line(token->pos), position_column(token->pos));
 }
\ No newline at end of file
@@ -6,75 +6,92 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "source.h"
+
+// Every token type with its display name and, for keywords, its spelling.
+// The TokenType enum, token_type_to_string and keyword recognition are all
+// generated from this one table, so a new keyword is a single line here.
+#define TOKEN_TYPES(X) \
+  X(TOKEN_EOF,               "EOF",                NULL) \
+  X(TOKEN_IDENTIFIER,        "IDENTIFIER",         NULL) \
+  X(TOKEN_STRING,            "STRING",             NULL) \
+  X(TOKEN_NUMBER,            "NUMBER",             NULL) \
+  X(TOKEN_KEYWORD_LET,       "LET",                "let") \
+  X(TOKEN_KEYWORD_FIXED,     "FIXED",              "fixed") \
+  X(TOKEN_KEYWORD_FNC,       "FNC",                "fnc") \
+  X(TOKEN_KEYWORD_RETURN,    "RETURN",             "return") \
+  X(TOKEN_KEYWORD_PUB,       "PUB",                "pub") \
+  X(TOKEN_KEYWORD_IMPORT,    "IMPORT",             "import") \
+  X(TOKEN_KEYWORD_AS,        "AS",                 "as") \
+  X(TOKEN_PRINT,             "PRINT",              "print") \
+  X(TOKEN_PRINTLN,           "PRINTLN",            "println") \
+  X(TOKEN_COLON,             "COLON",              NULL) \
+  X(TOKEN_SEMICOLON,         "SEMICOLON",          NULL) \
+  X(TOKEN_COMMA,             "COMMA",              NULL) \
+  X(TOKEN_DOT,               "DOT",                NULL) \
+  X(TOKEN_ARROW,             "ARROW",              NULL) \
+  X(TOKEN_ASSIGN,            "ASSIGN",             NULL) \
+  X(TOKEN_PLUS,              "PLUS",               NULL) \
+  X(TOKEN_MINUS,             "MINUS",              NULL) \
+  X(TOKEN_MULTIPLY,          "MULTIPLY",           NULL) \
+  X(TOKEN_DIVIDE,            "DIVIDE",             NULL) \
+  X(TOKEN_MODULO,            "MODULO",             NULL) \
+  X(TOKEN_INT_DIVIDE,        "INT_DIVIDE",         NULL) \
+  X(TOKEN_LPAREN,            "LPAREN",             NULL) \
+  X(TOKEN_RPAREN,            "RPAREN",             NULL) \
+  X(TOKEN_LBRACE,            "LBRACE",             NULL) \
+  X(TOKEN_RBRACE,            "RBRACE",             NULL) \
+  X(TOKEN_LBRACKET,          "LBRACKET",           NULL) \
+  X(TOKEN_RBRACKET,          "RBRACKET",           NULL) \
+  X(TOKEN_COMMENT,           "COMMENT",            NULL) \
+  X(TOKEN_MULTILINE_COMMENT, "MULTILINE_COMMENT",  NULL) \
+  X(TOKEN_FORMAT_STRING,     "FORMAT_STRING",      NULL) \
+  X(TOKEN_DOLLAR_LBRACE,     "DOLLAR_LBRACE",      NULL) \
+  X(TOKEN_ERROR,             "ERROR",              NULL)
 
 typedef enum {
-  TOKEN_EOF,
-  TOKEN_IDENTIFIER,
-  TOKEN_STRING,
-  TOKEN_NUMBER,
-  TOKEN_KEYWORD_LET,
-  TOKEN_KEYWORD_FIXED,
-  TOKEN_KEYWORD_FNC,
-  TOKEN_KEYWORD_RETURN,
-  TOKEN_KEYWORD_PUB,
-  TOKEN_KEYWORD_IMPORT,
-  TOKEN_KEYWORD_AS,
-  TOKEN_PRINT,
-  TOKEN_PRINTLN,
-  TOKEN_COLON,
-  TOKEN_SEMICOLON,
-  TOKEN_COMMA,
-  TOKEN_DOT,
-  TOKEN_ARROW,
-  TOKEN_ASSIGN,
-  TOKEN_PLUS,
-  TOKEN_MINUS,
-  TOKEN_MULTIPLY,
-  TOKEN_DIVIDE,
-  TOKEN_MODULO,        // %%
-  TOKEN_INT_DIVIDE,
-  TOKEN_LPAREN,
-  TOKEN_RPAREN,
-  TOKEN_LBRACE,
-  TOKEN_RBRACE,
-  TOKEN_LBRACKET,
-  TOKEN_RBRACKET,
-  TOKEN_COMMENT,
-  TOKEN_MULTILINE_COMMENT,
-  TOKEN_FORMAT_STRING,
-  TOKEN_DOLLAR_LBRACE,
-  TOKEN_ERROR
+#define TOKEN_TYPE_ENUM(type, name, keyword) type,
+  TOKEN_TYPES(TOKEN_TYPE_ENUM)
+#undef TOKEN_TYPE_ENUM
 } TokenType;
 
-typedef struct {
-  int line;
-  int column;
-  char *filename;
-} Position;
-
+// A token is a span of the lexer's source buffer and stays valid until the
+// lexer is destroyed. String tokens cover the text between the quotes with
+// escapes left in place; token_string_value decodes them.
 typedef struct {
   TokenType type;
-  char *value;
+  const char *start;
+  size_t length;
   Position pos;
 } Token;
 
 typedef struct {
-  char *source;
+  const char *source;  // Borrowed; need not be NUL-terminated
   size_t pos;
   size_t length;
-  int line;
-  int column;
-  char *filename;
-  Token *tokens;
-  size_t token_count;
-  size_t token_capacity;
+  int file;          // Id in the source file table
+  LineTable *lines;  // That file's line starts, filled in while lexing
+  LineTable nested_lines; // Where a nested lexer records them instead
 } Lexer;
 
-Lexer *lexer_create(const char *source, const char *filename);
+// The lexer borrows `source`, which must outlive it and every token it
+// returns.
+Lexer *lexer_create(const char *source, size_t length, const char *filename);
+// A lexer over part of the buffer `parent` reads, such as one format string
+// placeholder, pointed at it with lexer_set_range. Its positions are
+// offsets in the parent's file, so it registers no file of its own; the
+// parent has already recorded the line starts it passes.
+Lexer *lexer_create_nested(const Lexer *parent);
 void lexer_destroy(Lexer *lexer);
-Token *lexer_tokenize(Lexer *lexer);
+// Lexes and returns the next token. Once the source is exhausted every call
+// returns TOKEN_EOF.
+Token lexer_next_token(Lexer *lexer);
+// Restarts lexing at `start` and treats `end` as the end of the source.
+// Ranges lexed one after another must not overlap and must move forward,
+// so the file's line table stays in order.
+void lexer_set_range(Lexer *lexer, size_t start, size_t end);
 const char *token_type_to_string(TokenType type);
 void token_print(Token *token);
-Position position_create(int line, int column, char *filename);
+char *token_string_value(const Token *token);
 
 #endif
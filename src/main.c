@@ -1,15 +1,24 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "lexer.h"
 #include "parser.h"
+#include "optimizer.h"
+#include "resolver.h"
 #include "interpreter.h"
 #include "import.h"
 #include "error.h"
+#include "source.h"
 
 #define VERSION "1.0.0"
 
+static bool tree_walk = false;
+static bool show_stats = false;
+static int optimize_level = 1;
+static int max_call_depth = CALL_DEPTH_DEFAULT;
+
 void print_usage(const char *program_name) {
     printf("Lizard Programming Language Interpreter v%s\n", VERSION);
     printf("Usage: %s [options] [file]\n", program_name);
@@ -17,6 +26,10 @@ void print_usage(const char *program_name) {
     printf("  -h, --help     Show this help message\n");
     printf("  -v, --version  Show version information\n");
     printf("  -i, --interactive  Start interactive mode (REPL)\n");
+    printf("  --tree-walk    Evaluate the AST directly instead of the bytecode VM\n");
+    printf("  --stats        Print execution counters to stderr when done\n");
+    printf("  -O0, -O1       Disable or enable (default) constant folding before running\n");
+    printf("  --max-depth N  Allow N nested function calls (default %d)\n", CALL_DEPTH_DEFAULT);
     printf("\nExamples:\n");
     printf("  %s hello.lz      # Run hello.lz file\n", program_name);
     printf("  %s -i            # Start interactive mode\n", program_name);
@@ -27,76 +40,56 @@ void print_version(void) {
     printf("Built with love for learning and experimentation.\n");
 }
 
-char *read_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
-        return NULL;
-    }
-    
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char *content = malloc(length + 1);
-    if (!content) {
-        fprintf(stderr, "Error: Memory allocation failed\n");
-        fclose(file);
-        return NULL;
-    }
-    
-    size_t read_length = fread(content, 1, length, file);
-    content[read_length] = '\0';
-    
-    fclose(file);
-    return content;
-}
-
 bool execute_file(const char *filename) {
-    char *source = read_file(filename);
-    if (!source) {
+    SourceText source;
+    if (!source_load(filename, &source)) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
         return false;
     }
     
-    // Create lexer
-    Lexer *lexer = lexer_create(source, filename);
+    // Create lexer; it reads the loaded text in place
+    Lexer *lexer = lexer_create(source.text, source.length, filename);
     if (!lexer) {
         fprintf(stderr, "Error: Failed to create lexer\n");
-        free(source);
-        return false;
-    }
-    
-    // Tokenize
-    Token *tokens = lexer_tokenize(lexer);
-    if (!tokens) {
-        fprintf(stderr, "Error: Tokenization failed\n");
-        lexer_destroy(lexer);
-        free(source);
+        source_release(&source);
         return false;
     }
     
-    // Create parser
-    Parser *parser = parser_create(tokens, lexer->token_count);
+    // Create parser; it pulls tokens from the lexer as it goes and builds
+    // the tree in an arena that lives as long as the program
+    Arena *arena = arena_create();
+    Parser *parser = parser_create(lexer, arena);
     if (!parser) {
         fprintf(stderr, "Error: Failed to create parser\n");
+        arena_destroy(arena);
         lexer_destroy(lexer);
-        free(source);
+        source_release(&source);
         return false;
     }
     
-    // Parse
+    // Parse. The AST copies what it needs from the tokens, so the source
+    // can be released before the program runs.
     ASTNode *ast = parser_parse(parser);
+    parser_destroy(parser);
+    lexer_destroy(lexer);
+    source_release(&source);
     if (!ast) {
         fprintf(stderr, "Error: Parsing failed\n");
-        parser_destroy(parser);
-        lexer_destroy(lexer);
-        free(source);
+        arena_destroy(arena);
         return false;
     }
+    if (optimize_level > 0) {
+        optimizer_run(ast, arena, true);
+    }
+    resolver_resolve(ast);
     
     // Process imports first
     ImportManager *import_manager = import_manager_create();
     Interpreter *interpreter = interpreter_create();
+    interpreter->tree_walk = tree_walk;
+    interpreter->collect_stats = show_stats;
+    interpreter->optimize_level = optimize_level;
+    interpreter->max_call_depth = max_call_depth;
     
     // Find and process import statements
     if (ast->type == AST_PROGRAM) {
@@ -107,10 +100,7 @@ bool execute_file(const char *filename) {
                     fprintf(stderr, "Error: Import processing failed\n");
                     import_manager_destroy(import_manager);
                     interpreter_destroy(interpreter);
-                    ast_destroy(ast);
-                    parser_destroy(parser);
-                    lexer_destroy(lexer);
-                    free(source);
+                    arena_destroy(arena);
                     return false;
                 }
             }
@@ -119,14 +109,14 @@ bool execute_file(const char *filename) {
     
     // Execute the program
     interpreter_run(interpreter, ast);
+    if (show_stats) {
+        interpreter_print_stats(interpreter);
+    }
     
     // Cleanup
     import_manager_destroy(import_manager);
     interpreter_destroy(interpreter);
-    ast_destroy(ast);
-    parser_destroy(parser);
-    lexer_destroy(lexer);
-    free(source);
+    arena_destroy(arena);
     
     return true;
 }
@@ -137,6 +127,11 @@ void interactive_mode(void) {
     
     ImportManager *import_manager = import_manager_create();
     Interpreter *interpreter = interpreter_create();
+    interpreter->tree_walk = tree_walk;
+    interpreter->collect_stats = show_stats;
+    interpreter->optimize_level = optimize_level;
+    interpreter->max_call_depth = max_call_depth;
+    Arena *arena = arena_create();  // Holds every line's tree for the session
     
     char input[1024];
     int line_number = 1;
@@ -170,22 +165,14 @@ void interactive_mode(void) {
         snprintf(temp_filename, sizeof(temp_filename), "<repl:%d>", line_number);
         
         // Create lexer
-        Lexer *lexer = lexer_create(input, temp_filename);
+        Lexer *lexer = lexer_create(input, strlen(input), temp_filename);
         if (!lexer) {
             printf("Error: Failed to create lexer\n");
             continue;
         }
         
-        // Tokenize
-        Token *tokens = lexer_tokenize(lexer);
-        if (!tokens) {
-            printf("Error: Tokenization failed\n");
-            lexer_destroy(lexer);
-            continue;
-        }
-        
-        // Create parser
-        Parser *parser = parser_create(tokens, lexer->token_count);
+        // Create parser; it pulls tokens from the lexer as it goes
+        Parser *parser = parser_create(lexer, arena);
         if (!parser) {
             printf("Error: Failed to create parser\n");
             lexer_destroy(lexer);
@@ -200,6 +187,12 @@ void interactive_mode(void) {
             lexer_destroy(lexer);
             continue;
         }
+        if (optimize_level > 0) {
+            // Earlier lines may have bound any name, so fixed names are not
+            // propagated.
+            optimizer_run(ast, arena, false);
+        }
+        resolver_resolve(ast);
         
         // Process imports if any
         if (ast->type == AST_PROGRAM) {
@@ -212,16 +205,10 @@ void interactive_mode(void) {
         }
         
         // Execute
-        Value *result = interpreter_evaluate(interpreter, ast);
-        if (result && result->type != VALUE_NULL) {
-            printf("=> ");
-            value_print(result);
-            printf("\n");
-            value_destroy(result);
-        }
+        interpreter_run(interpreter, ast);
         
-        // Cleanup
-        ast_destroy(ast);
+        // Cleanup. The tree stays in the session arena: functions declared
+        // on this line keep pointing into it.
         parser_destroy(parser);
         lexer_destroy(lexer);
         
@@ -229,9 +216,13 @@ void interactive_mode(void) {
     }
     
     printf("\nGoodbye!\n");
+    if (show_stats) {
+        interpreter_print_stats(interpreter);
+    }
     
     import_manager_destroy(import_manager);
     interpreter_destroy(interpreter);
+    arena_destroy(arena);
 }
 
 int main(int argc, char *argv[]) {
@@ -247,6 +238,21 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--version") == 0) {
             print_version();
             return 0;
+        } else if (strcmp(argv[i], "--tree-walk") == 0) {
+            tree_walk = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = true;
+        } else if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0) {
+            optimize_level = argv[i][2] - '0';
+        } else if (strcmp(argv[i], "--max-depth") == 0) {
+            char *end = NULL;
+            long depth = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (!end || *end != '\0' || depth < 1 || depth > INT_MAX) {
+                fprintf(stderr, "Error: --max-depth expects a positive number of calls\n");
+                return 1;
+            }
+            max_call_depth = (int)depth;
+            i++;
         } else if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--interactive") == 0) {
             interactive_mode();
             return 0;
@@ -0,0 +1,274 @@
+#include "optimizer.h"
+#include "interpreter.h"
+#include <limits.h>
+#include <stdlib.h>
+
+typedef struct {
+  Symbol *name;
+  const ASTNode *literal; // NULL hides an outer constant of the same name
+} Constant;
+
+typedef struct {
+  Arena *arena;
+  bool propagate_fixed;
+  Constant *constants;    // Innermost last
+  int count;
+  int capacity;
+  int visible;            // Constants below this index are out of reach
+} Optimizer;
+
+static void optimize_node(Optimizer *optimizer, ASTNode *node);
+
+static void constant_push(Optimizer *optimizer, Symbol *name,
+                          const ASTNode *literal) {
+  if (optimizer->count >= optimizer->capacity) {
+    optimizer->capacity = optimizer->capacity ? optimizer->capacity * 2 : 8;
+    optimizer->constants = realloc(optimizer->constants,
+                                   sizeof(Constant) * optimizer->capacity);
+  }
+  optimizer->constants[optimizer->count].name = name;
+  optimizer->constants[optimizer->count].literal = literal;
+  optimizer->count++;
+}
+
+static const ASTNode *constant_find(Optimizer *optimizer, Symbol *name) {
+  for (int i = optimizer->count - 1; i >= optimizer->visible; i--) {
+    if (optimizer->constants[i].name == name)
+      return optimizer->constants[i].literal;
+  }
+  return NULL;
+}
+
+static bool is_number(Value value) {
+  return value.type == VALUE_INT || value.type == VALUE_FLOAT;
+}
+
+static double number_of(Value value) {
+  return value.type == VALUE_INT ? value.int_val : value.float_val;
+}
+
+// True when interpreter_binary_operation would succeed without reporting
+// anything, so evaluating it now cannot change what the program prints.
+static bool binary_folds(TokenType operator, Value left, Value right) {
+  switch (operator) {
+  case TOKEN_PLUS:
+    return left.type == VALUE_STRING || right.type == VALUE_STRING ||
+           (is_number(left) && is_number(right));
+  case TOKEN_MINUS:
+  case TOKEN_MULTIPLY:
+    return is_number(left) && is_number(right);
+  case TOKEN_DIVIDE:
+    return is_number(left) && is_number(right) && number_of(right) != 0;
+  case TOKEN_MODULO:
+  case TOKEN_INT_DIVIDE:
+    // INT_MIN by -1 overflows; leave it to trap at runtime as it always has.
+    return left.type == VALUE_INT && right.type == VALUE_INT &&
+           right.int_val != 0 &&
+           !(right.int_val == -1 && left.int_val == INT_MIN);
+  default:
+    return false;
+  }
+}
+
+// Turns `node` into a literal holding `value`, which it takes over. The
+// node keeps its position.
+static void become_literal(Optimizer *optimizer, ASTNode *node, Value value) {
+  if (value.type == VALUE_STRING) {
+    // The tree's arena takes the reference, as for parsed literals.
+    if (!string_attach(optimizer->arena, value.string_val))
+      return;
+  }
+  node->type = AST_LITERAL;
+  node->literal.value = value;
+}
+
+static void fold_binary(Optimizer *optimizer, ASTNode *node) {
+  ASTNode *left = node->binary_expression.left;
+  ASTNode *right = node->binary_expression.right;
+  optimize_node(optimizer, left);
+  optimize_node(optimizer, right);
+
+  if (left->type != AST_LITERAL || right->type != AST_LITERAL)
+    return;
+  TokenType operator = node->binary_expression.operator;
+  if (!binary_folds(operator, left->literal.value, right->literal.value))
+    return;
+
+  Value result = interpreter_binary_operation(
+      operator, left->literal.value, right->literal.value, node->pos);
+  if (!value_is_none(result))
+    become_literal(optimizer, node, result);
+}
+
+static void fold_unary(Optimizer *optimizer, ASTNode *node) {
+  ASTNode *operand = node->unary_expression.operand;
+  optimize_node(optimizer, operand);
+
+  // Unary plus is rejected at runtime, so only minus is folded.
+  if (node->unary_expression.operator != TOKEN_MINUS ||
+      operand->type != AST_LITERAL || !is_number(operand->literal.value))
+    return;
+
+  become_literal(optimizer, node,
+                 interpreter_unary_operation(TOKEN_MINUS, operand->literal.value,
+                                             node->pos));
+}
+
+static void propagate_identifier(Optimizer *optimizer, ASTNode *node) {
+  const ASTNode *literal = constant_find(optimizer, node->identifier.name);
+  if (!literal)
+    return;
+
+  // Literal values are only ever copied out of the tree, so the two nodes
+  // can share a string.
+  node->type = AST_LITERAL;
+  node->literal.value = literal->literal.value;
+}
+
+static Symbol *declared_name(const ASTNode *statement) {
+  if (statement->type == AST_VARIABLE_DECLARATION)
+    return statement->variable_declaration.name;
+  if (statement->type == AST_FUNCTION_DECLARATION)
+    return statement->function_declaration.name;
+  return NULL;
+}
+
+static bool declared_before(ASTNode **statements, int index, Symbol *name) {
+  for (int i = 0; i < index; i++) {
+    if (declared_name(statements[i]) == name)
+      return true;
+  }
+  return false;
+}
+
+// Optimizes a program's or block's statements in order. A fixed literal
+// declaration becomes visible to the statements after it unless the name
+// was already bound in this list, in which case the declaration fails at
+// runtime and reads keep finding the first binding.
+static void optimize_statements(Optimizer *optimizer, ASTNode **statements,
+                                int count) {
+  int mark = optimizer->count;
+
+  for (int i = 0; i < count; i++) {
+    ASTNode *statement = statements[i];
+    optimize_node(optimizer, statement);
+
+    if (!optimizer->propagate_fixed ||
+        statement->type != AST_VARIABLE_DECLARATION)
+      continue;
+    ASTNode *initializer = statement->variable_declaration.initializer;
+    if (statement->variable_declaration.is_fixed && initializer &&
+        initializer->type == AST_LITERAL &&
+        type_accepts(statement->variable_declaration.var_type,
+                     initializer->literal.value) &&
+        !declared_before(statements, i, statement->variable_declaration.name)) {
+      constant_push(optimizer, statement->variable_declaration.name, initializer);
+    }
+  }
+
+  optimizer->count = mark;
+}
+
+static void optimize_block(Optimizer *optimizer, ASTNode *node) {
+  int mark = optimizer->count;
+
+  // A name the block declares anywhere may be read from either binding
+  // depending on where the read sits, so outer constants of that name are
+  // hidden for the whole block.
+  for (int i = 0; i < node->block_statement.statement_count; i++) {
+    Symbol *name = declared_name(node->block_statement.statements[i]);
+    if (name && constant_find(optimizer, name))
+      constant_push(optimizer, name, NULL);
+  }
+
+  optimize_statements(optimizer, node->block_statement.statements,
+                      node->block_statement.statement_count);
+  optimizer->count = mark;
+}
+
+static void optimize_function(Optimizer *optimizer, ASTNode *node) {
+  // A function runs in its caller's scope, so nothing outside it is known.
+  int visible = optimizer->visible;
+  optimizer->visible = optimizer->count;
+
+  for (int i = 0; i < node->function_declaration.param_count; i++) {
+    if (node->function_declaration.param_has_default[i])
+      optimize_node(optimizer, node->function_declaration.param_defaults[i]);
+  }
+  optimize_node(optimizer, node->function_declaration.body);
+
+  optimizer->visible = visible;
+}
+
+static void optimize_node(Optimizer *optimizer, ASTNode *node) {
+  if (!node)
+    return;
+
+  switch (node->type) {
+  case AST_PROGRAM:
+    optimize_statements(optimizer, node->program.statements,
+                        node->program.statement_count);
+    break;
+
+  case AST_VARIABLE_DECLARATION:
+    optimize_node(optimizer, node->variable_declaration.initializer);
+    break;
+
+  case AST_FUNCTION_DECLARATION:
+    optimize_function(optimizer, node);
+    break;
+
+  case AST_RETURN_STATEMENT:
+    optimize_node(optimizer, node->return_statement.expression);
+    break;
+
+  case AST_EXPRESSION_STATEMENT:
+    optimize_node(optimizer, node->expression_statement.expression);
+    break;
+
+  case AST_BLOCK_STATEMENT:
+    optimize_block(optimizer, node);
+    break;
+
+  case AST_PRINT_STATEMENT:
+    optimize_node(optimizer, node->print_statement.expression);
+    break;
+
+  case AST_FUNCTION_CALL:
+    for (int i = 0; i < node->function_call.argument_count; i++) {
+      optimize_node(optimizer, node->function_call.arguments[i]);
+    }
+    break;
+
+  case AST_BINARY_EXPRESSION:
+    fold_binary(optimizer, node);
+    break;
+
+  case AST_UNARY_EXPRESSION:
+    fold_unary(optimizer, node);
+    break;
+
+  case AST_IDENTIFIER:
+    propagate_identifier(optimizer, node);
+    break;
+
+  case AST_FORMAT_STRING:
+    for (int i = 0; i < node->format_string.expression_count; i++) {
+      optimize_node(optimizer, node->format_string.expressions[i]);
+    }
+    break;
+
+  case AST_ASSIGNMENT_EXPRESSION:
+    optimize_node(optimizer, node->assignment_expression.value);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void optimizer_run(ASTNode *program, Arena *arena, bool propagate_fixed) {
+  Optimizer optimizer = {arena, propagate_fixed, NULL, 0, 0, 0};
+  optimize_node(&optimizer, program);
+  free(optimizer.constants);
+}
@@ -0,0 +1,22 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "parser.h"
+
+// Runs between parser_parse and resolver_resolve and rewrites the tree in
+// place. Arithmetic, string concatenation and unary minus over literals are
+// folded into a single literal; an operation that would fail at runtime,
+// such as a division by zero, is left alone so it is still reported when
+// and where it runs. Strings made by folding are allocated from `arena`,
+// like the rest of the tree.
+//
+// With `propagate_fixed`, a read of a `fixed let` name initialized with a
+// literal is replaced by that literal where the read is certain to find the
+// declaration: later in the same statement list, or in a nested block that
+// does not declare the name again. Function bodies are not entered from
+// outside, since a function sees its caller's names. This is only sound
+// when the tree is a whole compilation unit; a REPL line may rebind names
+// earlier lines declared.
+void optimizer_run(ASTNode *program, Arena *arena, bool propagate_fixed);
+
+#endif
@@ -1,35 +1,34 @@
 #include "parser.h"
 #include "error.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_ARGS 100
-#define MAX_PARAMS 100
-#define MAX_STATEMENTS 1000
-#define MAX_IMPORTS 100
-#define MAX_FORMAT_EXPRESSIONS 1000
-
-Parser *parser_create(Token *tokens, size_t token_count) {
+Parser *parser_create(Lexer *lexer, Arena *arena) {
   Parser *parser = malloc(sizeof(Parser));
   if (!parser)
     return NULL;
 
-  parser->tokens = tokens;
-  parser->token_count = token_count;
+  parser->lexer = lexer;
+  parser->arena = arena;
   parser->current = 0;
+  parser->filled = 0;
+  parser->pending = NULL;
+  parser->pending_count = 0;
+  parser->pending_capacity = 0;
   return parser;
 }
 
-bool validate_type_assignment(const char* declared_type, Value* value) {
-    if (!declared_type || !value) return true;
+bool validate_type_assignment(const char* declared_type, Value value) {
+    if (!declared_type || value_is_none(value)) return true;
     
-    const char* value_type = value_type_to_string(value->type);
+    const char* value_type = value_type_to_string(value.type);
     
     if (strcmp(declared_type, value_type) == 0) {
         return true;
     }
     
-    if (strcmp(declared_type, "float") == 0 && value->type == VALUE_INT) {
+    if (strcmp(declared_type, "float") == 0 && value.type == VALUE_INT) {
         return true;
     }
     
@@ -38,26 +37,80 @@ bool validate_type_assignment(const char* declared_type, Value* value) {
 
 void parser_destroy(Parser *parser) {
   if (parser) {
+    free(parser->pending);
     free(parser);
   }
 }
 
-static Token *parser_current_token(Parser *parser) {
-  if (parser->current >= parser->token_count) {
-    return &parser->tokens[parser->token_count - 1]; // EOF token
+// Child lists have no fixed size. Their items are pushed onto the parser's
+// pending stack, which grows by doubling, and copied into the arena at their
+// final length once the list is closed, so the tree keeps no slack. Lists
+// nest the way the grammar does: an inner list is always closed before the
+// outer one gets its next item, so each list is the run of items above the
+// `base` it started at.
+static bool parser_list_push(Parser *parser, void *item) {
+  if (parser->pending_count == parser->pending_capacity) {
+    size_t capacity = parser->pending_capacity ? parser->pending_capacity * 2 : 64;
+    void **grown = realloc(parser->pending, sizeof(void *) * capacity);
+    if (!grown)
+      return false;
+    parser->pending = grown;
+    parser->pending_capacity = capacity;
   }
-  return &parser->tokens[parser->current];
+  parser->pending[parser->pending_count++] = item;
+  return true;
 }
 
-static Token *parser_peek_token(Parser *parser) {
-  if (parser->current + 1 >= parser->token_count) {
-    return &parser->tokens[parser->token_count - 1];
+// Items pushed since `base`, in groups of `stride`.
+static int parser_list_length(Parser *parser, size_t base, size_t stride) {
+  return (int)((parser->pending_count - base) / stride);
+}
+
+// Copies item `column` of each group of `stride` pushed since `base` into an
+// array in the arena. Parallel lists such as parameter names and types are
+// pushed side by side and taken apart one column at a time.
+static void *parser_list_column(Parser *parser, size_t base, size_t stride,
+                                size_t column) {
+  size_t count = (parser->pending_count - base) / stride;
+  void **items = arena_alloc(parser->arena, sizeof(void *) * count);
+  if (!items)
+    return NULL;
+
+  for (size_t i = 0; i < count; i++)
+    items[i] = parser->pending[base + i * stride + column];
+  return items;
+}
+
+// Closes a list of single items: returns it as an arena array and pops it.
+static void *parser_list_finish(Parser *parser, size_t base, int *count) {
+  *count = parser_list_length(parser, base, 1);
+  void *items = parser_list_column(parser, base, 1, 0);
+  parser->pending_count = base;
+  return items;
+}
+
+// The token `ahead` places past the current one, lexed on first use. The
+// lexer keeps returning EOF at the end, so this never runs dry.
+static Token *parser_token_at(Parser *parser, size_t ahead) {
+  size_t index = parser->current + ahead;
+  while (parser->filled <= index) {
+    parser->lookahead[parser->filled % PARSER_LOOKAHEAD] =
+        lexer_next_token(parser->lexer);
+    parser->filled++;
   }
-  return &parser->tokens[parser->current + 1];
+  return &parser->lookahead[index % PARSER_LOOKAHEAD];
+}
+
+static Token *parser_current_token(Parser *parser) {
+  return parser_token_at(parser, 0);
+}
+
+static Token *parser_peek_token(Parser *parser) {
+  return parser_token_at(parser, 1);
 }
 
 static void parser_advance(Parser *parser) {
-  if (parser->current < parser->token_count - 1) {
+  if (parser_current_token(parser)->type != TOKEN_EOF) {
     parser->current++;
   }
 }
@@ -84,10 +137,9 @@ static bool parser_expect(Parser *parser, TokenType type, const char *message) {
 }
 static ASTNode *parser_parse_expression(Parser *parser);
 static ASTNode *parser_parse_statement(Parser *parser);
-static ASTNode *parser_parse_expression_from_string(Parser *parser, const char *expr_str);
 
-static ASTNode *ast_create_node(ASTNodeType type, Position pos) {
-  ASTNode *node = malloc(sizeof(ASTNode));
+static ASTNode *ast_create_node(Parser *parser, ASTNodeType type, Position pos) {
+  ASTNode *node = arena_alloc(parser->arena, sizeof(ASTNode));
   if (!node)
     return NULL;
 
@@ -95,35 +147,86 @@ static ASTNode *ast_create_node(ASTNodeType type, Position pos) {
   node->type = type;
   node->pos = pos;
 
-  if (pos.filename && strlen(pos.filename) > 0) {
-    node->pos.filename = strdup(pos.filename);
-  } else {
-    node->pos.filename = NULL;
+  // Until the resolver runs, every name is looked up dynamically.
+  switch (type) {
+  case AST_VARIABLE_DECLARATION:
+    node->variable_declaration.slot = -1;
+    break;
+  case AST_FUNCTION_DECLARATION:
+    node->function_declaration.slot = -1;
+    break;
+  case AST_ASSIGNMENT_EXPRESSION:
+    node->assignment_expression.where = ENV_SLOT_DYNAMIC;
+    break;
+  case AST_FUNCTION_CALL:
+    node->function_call.where = ENV_SLOT_DYNAMIC;
+    break;
+  case AST_IDENTIFIER:
+    node->identifier.where = ENV_SLOT_DYNAMIC;
+    break;
+  default:
+    break;
   }
 
   return node;
 }
 
-static ASTNode *parser_parse_format_string(Parser *parser, const char *template) {
-    ASTNode *node = ast_create_node(AST_FORMAT_STRING, parser_current_token(parser)->pos);
-    if (!node) return NULL;
-
-    node->format_string.template = strdup(template);
-    if (!node->format_string.template) {
-        ast_destroy(node);
-        return NULL;
+// Walks a string token's decoded text and its source together, so that a
+// placeholder found in the text can be lexed where it sits in the source.
+typedef struct {
+    size_t decoded;
+    size_t raw;
+} TemplateCursor;
+
+// Offset in the token's source of `decoded`, which must not be behind the
+// cursor. An escape is two source characters for one decoded character.
+static size_t template_source_offset(const Token *token, TemplateCursor *cursor,
+                                     size_t decoded) {
+    while (cursor->decoded < decoded && cursor->raw < token->length) {
+        bool escape = token->start[cursor->raw] == '\\' &&
+                      cursor->raw + 1 < token->length;
+        cursor->raw += escape ? 2 : 1;
+        cursor->decoded++;
     }
+    return cursor->raw;
+}
+
+// Placeholders are parsed by one nested lexer and parser, pointed at each
+// "${...}" in the source in turn, so their positions are real lines and
+// columns of the script and no file is registered per format string.
+static ASTNode *parser_parse_placeholder(Parser *format_parser, const Token *token,
+                                         TemplateCursor *cursor, size_t start,
+                                         size_t end) {
+    size_t base = (size_t)(token->start - format_parser->lexer->source);
+    size_t source_start = base + template_source_offset(token, cursor, start);
+    size_t source_end = base + template_source_offset(token, cursor, end);
+    lexer_set_range(format_parser->lexer, source_start, source_end);
+    format_parser->current = 0;
+    format_parser->filled = 0;
+    return parser_parse_expression(format_parser);
+}
+
+static ASTNode *parser_parse_format_string(Parser *parser, const Token *token,
+                                          const char *text) {
+    ASTNode *node = ast_create_node(parser, AST_FORMAT_STRING, parser_current_token(parser)->pos);
+    if (!node) return NULL;
 
-    node->format_string.expressions = malloc(sizeof(ASTNode *) * MAX_FORMAT_EXPRESSIONS);
-    if (!node->format_string.expressions) {
-        ast_destroy(node);
+    char *template = arena_strdup(parser->arena, text);
+    if (!template) {
         return NULL;
     }
+    node->format_string.template = template;
 
-    node->format_string.expression_count = 0;
+    Lexer *lexer = NULL;
+    Parser *format_parser = NULL;
+    ASTNode *result = NULL;
+    TemplateCursor cursor = {0, 0};
 
+    // Each placeholder is pushed as where its "${" starts, where its '}'
+    // ends and its expression; the literals are the gaps in between.
+    size_t base = parser->pending_count;
     const char *pos = template;
-    while (*pos && node->format_string.expression_count < MAX_FORMAT_EXPRESSIONS) {
+    while (*pos) {
         const char *start = strstr(pos, "${");
         if (!start) break;
         
@@ -139,68 +242,107 @@ static ASTNode *parser_parse_format_string(Parser *parser, const char *template)
             error_report(ERROR_PARSER, parser_current_token(parser)->pos, 
                         "Unmatched braces in format string",
                         "Make sure all ${} are properly closed");
-            ast_destroy(node);
-            return NULL;
+            goto done;
         }
         
-        // Extract expression string (without ${ and })
-        size_t expr_len = end - start - 3; // -3 for ${ and }
-        char *expr_str = malloc(expr_len + 1);
-        if (!expr_str) {
-            ast_destroy(node);
-            return NULL;
+        if (!format_parser) {
+            lexer = lexer_create_nested(parser->lexer);
+            format_parser = parser_create(lexer, parser->arena);
+            if (!format_parser) goto done;
         }
-        strncpy(expr_str, start + 2, expr_len);
-        expr_str[expr_len] = '\0';
-        
-        ASTNode *expr_node = parser_parse_expression_from_string(parser, expr_str);
-        free(expr_str);
-        
+
+        // The expression sits between "${" and the closing '}'.
+        ASTNode *expr_node = parser_parse_placeholder(
+            format_parser, token, &cursor, start + 2 - template, end - 1 - template);
         if (!expr_node) {
-            ast_destroy(node);
-            return NULL;
+            goto done;
         }
         
-        node->format_string.expressions[node->format_string.expression_count++] = expr_node;
+        if (!parser_list_push(parser, (void *)start) ||
+            !parser_list_push(parser, (void *)end) ||
+            !parser_list_push(parser, expr_node)) {
+            goto done;
+        }
         pos = end;
     }
 
-    return node;
+    int count = parser_list_length(parser, base, 3);
+    FormatTemplate *segments = &node->format_string.segments;
+    segments->literals = arena_alloc(parser->arena, sizeof(FormatSlice) * (count + 1));
+    segments->placeholders = arena_alloc(parser->arena, sizeof(FormatSlice) * count);
+    node->format_string.expression_count = count;
+    node->format_string.expressions = parser_list_column(parser, base, 3, 2);
+    if (!segments->literals || !segments->placeholders ||
+        !node->format_string.expressions) {
+        goto done;
+    }
+
+    const char *literal = template;
+    segments->literal_length = 0;
+    for (int i = 0; i < count; i++) {
+        const char *start = parser->pending[base + i * 3];
+        const char *end = parser->pending[base + i * 3 + 1];
+        segments->literals[i].text = literal;
+        segments->literals[i].length = start - literal;
+        segments->placeholders[i].text = start;
+        segments->placeholders[i].length = end - start;
+        segments->literal_length += start - literal;
+        literal = end;
+    }
+    segments->literals[count].text = literal;
+    segments->literals[count].length = strlen(literal);
+    segments->literal_length += segments->literals[count].length;
+    parser->pending_count = base;
+    result = node;
+
+done:
+    parser_destroy(format_parser);
+    lexer_destroy(lexer);
+    return result;
 }
 
-static ASTNode *parser_parse_expression_from_string(Parser *parser __attribute__((unused)), const char *expr_str) {
-    Lexer *lexer = lexer_create(expr_str, "<format_string>");
-    if (!lexer) return NULL;
+static Symbol *token_symbol(Token *token) {
+  return symbol_intern_length(token->start, token->length);
+}
 
-    Token *tokens = lexer_tokenize(lexer);
-    if (!tokens) {
-        lexer_destroy(lexer);
-        return NULL;
-    }
-    
-    size_t token_count = lexer->token_count;
-    
-    Parser *temp_parser = parser_create(tokens, token_count);
-    if (!temp_parser) {
-        lexer_destroy(lexer);
-        return NULL;
-    }
-    
-    ASTNode *expr_node = parser_parse_expression(temp_parser);
+static char *token_text(Parser *parser, Token *token) {
+  return arena_strndup(parser->arena, token->start, token->length);
+}
 
-    parser_destroy(temp_parser);
-    lexer_destroy(lexer);
-    
-    return expr_node;
+// Number tokens may group digits with '_', which is dropped here.
+static Value parser_number_value(Token *token) {
+  char small[64];
+  char *digits = token->length < sizeof(small) ? small : malloc(token->length + 1);
+  size_t length = 0;
+  bool is_float = false;
+
+  for (size_t i = 0; i < token->length; i++) {
+    if (token->start[i] == '_')
+      continue;
+    if (token->start[i] == '.')
+      is_float = true;
+    digits[length++] = token->start[i];
+  }
+  digits[length] = '\0';
+
+  Value value = is_float ? value_create_float(atof(digits))
+                         : value_create_int(atoi(digits));
+  if (digits != small)
+    free(digits);
+  return value;
 }
 
-static ASTNode *parser_process_string_literal(Parser *parser, const char *str_value, Position pos) {
+static ASTNode *parser_process_string_literal(Parser *parser, const Token *token,
+                                              const char *str_value) {
   if (str_value && strchr(str_value, '$') && strchr(str_value, '{') && strchr(str_value, '}')) {
-    return parser_parse_format_string(parser, str_value);
+    return parser_parse_format_string(parser, token, str_value);
   } else {
-    ASTNode *node = ast_create_node(AST_LITERAL, pos);
+    ASTNode *node = ast_create_node(parser, AST_LITERAL, token->pos);
     if (!node) return NULL;
-    node->literal.value = value_create_string(str_value);
+    // The arena holds the string; evaluation and the compiler only retain it.
+    String *string = string_create_literal(parser->arena, str_value, strlen(str_value));
+    if (!string) return NULL;
+    node->literal.value = value_from_string(string);
     return node;
   }
 }
@@ -210,21 +352,20 @@ static ASTNode *parser_parse_primary(Parser *parser) {
 
   if (token->type == TOKEN_NUMBER) {
     parser_advance(parser);
-    ASTNode *node = ast_create_node(AST_LITERAL, token->pos);
+    ASTNode *node = ast_create_node(parser, AST_LITERAL, token->pos);
     if (!node)
       return NULL;
 
-    if (strchr(token->value, '.')) {
-      node->literal.value = value_create_float(atof(token->value));
-    } else {
-      node->literal.value = value_create_int(atoi(token->value));
-    }
+    node->literal.value = parser_number_value(token);
     return node;
   }
 
   if (token->type == TOKEN_STRING) {
     parser_advance(parser);
-    return parser_process_string_literal(parser, token->value, token->pos);
+    char *text = token_string_value(token);
+    ASTNode *node = parser_process_string_literal(parser, token, text);
+    free(text);
+    return node;
   }
 
   if (token->type == TOKEN_IDENTIFIER) {
@@ -233,52 +374,44 @@ static ASTNode *parser_parse_primary(Parser *parser) {
     if (parser_current_token(parser)->type == TOKEN_LPAREN) {
       parser_advance(parser); // consume '('
 
-      ASTNode *node = ast_create_node(AST_FUNCTION_CALL, token->pos);
+      ASTNode *node = ast_create_node(parser, AST_FUNCTION_CALL, token->pos);
       if (!node)
         return NULL;
 
-      node->function_call.name = strdup(token->value);
+      node->function_call.name = token_symbol(token);
       if (!node->function_call.name) {
-        ast_destroy(node);
-        return NULL;
-      }
-
-      node->function_call.arguments = malloc(sizeof(ASTNode *) * 100);
-      if (!node->function_call.arguments) {
-        ast_destroy(node);
         return NULL;
       }
 
-      node->function_call.argument_count = 0;
-
+      size_t base = parser->pending_count;
       if (parser_current_token(parser)->type != TOKEN_RPAREN) {
         do {
           ASTNode *arg = parser_parse_expression(parser);
-          if (!arg) {
-            ast_destroy(node);
+          if (!arg || !parser_list_push(parser, arg)) {
             return NULL;
           }
-
-          node->function_call.arguments[node->function_call.argument_count++] =
-              arg;
         } while (parser_match(parser, TOKEN_COMMA));
       }
 
       if (!parser_expect(parser, TOKEN_RPAREN,
                          "Expected ')' after function arguments")) {
-        ast_destroy(node);
+        return NULL;
+      }
+
+      node->function_call.arguments = parser_list_finish(
+          parser, base, &node->function_call.argument_count);
+      if (!node->function_call.arguments) {
         return NULL;
       }
       return node;
     }
 
-    ASTNode *node = ast_create_node(AST_IDENTIFIER, token->pos);
+    ASTNode *node = ast_create_node(parser, AST_IDENTIFIER, token->pos);
     if (!node)
       return NULL;
 
-    node->identifier.name = strdup(token->value);
+    node->identifier.name = token_symbol(token);
     if (!node->identifier.name) {
-      ast_destroy(node);
       return NULL;
     }
     return node;
@@ -290,7 +423,6 @@ static ASTNode *parser_parse_primary(Parser *parser) {
       return NULL;
 
     if (!parser_expect(parser, TOKEN_RPAREN, "Expected ')' after expression")) {
-      ast_destroy(expr);
       return NULL;
     }
     return expr;
@@ -312,7 +444,7 @@ static ASTNode *parser_parse_print_statement(Parser *parser) {
     return NULL;
   }
 
-  ASTNode *node = ast_create_node(AST_PRINT_STATEMENT, token->pos);
+  ASTNode *node = ast_create_node(parser, AST_PRINT_STATEMENT, token->pos);
   if (!node)
     return NULL;
 
@@ -320,7 +452,6 @@ static ASTNode *parser_parse_print_statement(Parser *parser) {
 
   ASTNode *expr = parser_parse_expression(parser);
   if (!expr) {
-    ast_destroy(node);
     return NULL;
   }
 
@@ -328,7 +459,6 @@ static ASTNode *parser_parse_print_statement(Parser *parser) {
 
   if (!parser_expect(parser, TOKEN_RPAREN,
                      "Expected ')' after print expression")) {
-    ast_destroy(node);
     return NULL;
   }
 
@@ -341,7 +471,7 @@ static ASTNode *parser_parse_unary(Parser *parser) {
 
   if (token->type == TOKEN_MINUS || token->type == TOKEN_PLUS) {
     parser_advance(parser);
-    ASTNode *node = ast_create_node(AST_UNARY_EXPRESSION, token->pos);
+    ASTNode *node = ast_create_node(parser, AST_UNARY_EXPRESSION, token->pos);
     if (!node)
       return NULL;
 
@@ -349,7 +479,6 @@ static ASTNode *parser_parse_unary(Parser *parser) {
     node->unary_expression.operand = parser_parse_unary(parser);
 
     if (!node->unary_expression.operand) {
-      ast_destroy(node);
       return NULL;
     }
     return node;
@@ -370,9 +499,8 @@ static ASTNode *parser_parse_multiplicative(Parser *parser) {
     Token *op = parser_current_token(parser);
     parser_advance(parser);
 
-    ASTNode *node = ast_create_node(AST_BINARY_EXPRESSION, op->pos);
+    ASTNode *node = ast_create_node(parser, AST_BINARY_EXPRESSION, op->pos);
     if (!node) {
-      ast_destroy(left);
       return NULL;
     }
 
@@ -381,7 +509,6 @@ static ASTNode *parser_parse_multiplicative(Parser *parser) {
     node->binary_expression.right = parser_parse_unary(parser);
 
     if (!node->binary_expression.right) {
-      ast_destroy(node);
       return NULL;
     }
 
@@ -401,9 +528,8 @@ static ASTNode *parser_parse_additive(Parser *parser) {
     Token *op = parser_current_token(parser);
     parser_advance(parser);
 
-    ASTNode *node = ast_create_node(AST_BINARY_EXPRESSION, op->pos);
+    ASTNode *node = ast_create_node(parser, AST_BINARY_EXPRESSION, op->pos);
     if (!node) {
-      ast_destroy(left);
       return NULL;
     }
 
@@ -412,7 +538,6 @@ static ASTNode *parser_parse_additive(Parser *parser) {
     node->binary_expression.right = parser_parse_multiplicative(parser);
 
     if (!node->binary_expression.right) {
-      ast_destroy(node);
       return NULL;
     }
 
@@ -442,12 +567,12 @@ static ASTNode *parser_parse_variable_declaration(Parser *parser) {
         return NULL;
     }
 
-    ASTNode *node = ast_create_node(AST_VARIABLE_DECLARATION, start_token->pos);
+    ASTNode *node = ast_create_node(parser, AST_VARIABLE_DECLARATION, start_token->pos);
     node->variable_declaration.is_fixed = is_fixed;
 
     if (parser_current_token(parser)->type == TOKEN_IDENTIFIER &&
         parser_peek_token(parser)->type == TOKEN_COLON) {
-        node->variable_declaration.var_type = strdup(parser_current_token(parser)->value);
+        node->variable_declaration.var_type = type_intern(token_symbol(parser_current_token(parser)));
         parser_advance(parser); // consume type
         parser_advance(parser); // consume ':'
 
@@ -458,10 +583,10 @@ static ASTNode *parser_parse_variable_declaration(Parser *parser) {
             return NULL;
         }
 
-        node->variable_declaration.name = strdup(parser_current_token(parser)->value);
+        node->variable_declaration.name = token_symbol(parser_current_token(parser));
         parser_advance(parser);
     } else if (parser_current_token(parser)->type == TOKEN_IDENTIFIER) {
-        node->variable_declaration.name = strdup(parser_current_token(parser)->value);
+        node->variable_declaration.name = token_symbol(parser_current_token(parser));
         node->variable_declaration.var_type = NULL;
         parser_advance(parser);
     } else {
@@ -483,30 +608,33 @@ static ASTNode *parser_parse_variable_declaration(Parser *parser) {
 
 static ASTNode *parser_parse_block_statement(Parser *parser) {
   Token *token = parser_current_token(parser);
-  ASTNode *node = ast_create_node(AST_BLOCK_STATEMENT, token->pos);
+  ASTNode *node = ast_create_node(parser, AST_BLOCK_STATEMENT, token->pos);
   if (!node)
     return NULL;
 
-  node->block_statement.statements = malloc(sizeof(ASTNode *) * 100);
-  if (!node->block_statement.statements) {
-    ast_destroy(node);
-    return NULL;
-  }
-  node->block_statement.statement_count = 0;
+  node->block_statement.needs_scope = true;
 
+  size_t base = parser->pending_count;
   while (parser_current_token(parser)->type != TOKEN_RBRACE &&
          parser_current_token(parser)->type != TOKEN_EOF) {
+    size_t top = parser->pending_count;
     ASTNode *stmt = parser_parse_statement(parser);
     if (stmt) {
-      node->block_statement
-          .statements[node->block_statement.statement_count++] = stmt;
+      if (!parser_list_push(parser, stmt))
+        return NULL;
     } else {
+      parser->pending_count = top; // Drop whatever the failed statement left
       parser_advance(parser);
     }
   }
 
   if (!parser_expect(parser, TOKEN_RBRACE, "Expected '}' after block")) {
-    ast_destroy(node);
+    return NULL;
+  }
+
+  node->block_statement.statements = parser_list_finish(
+      parser, base, &node->block_statement.statement_count);
+  if (!node->block_statement.statements) {
     return NULL;
   }
   return node;
@@ -524,7 +652,7 @@ static ASTNode *parser_parse_function_declaration(Parser *parser) {
     parser_advance(parser); // consume 'fnc'
   }
 
-  ASTNode *node = ast_create_node(AST_FUNCTION_DECLARATION, fnc_token->pos);
+  ASTNode *node = ast_create_node(parser, AST_FUNCTION_DECLARATION, fnc_token->pos);
   if (!node)
     return NULL;
 
@@ -533,56 +661,36 @@ static ASTNode *parser_parse_function_declaration(Parser *parser) {
   if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
     error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                  "Expected function name", "Functions must have a name");
-    ast_destroy(node);
     return NULL;
   }
 
-  node->function_declaration.name = strdup(parser_current_token(parser)->value);
+  node->function_declaration.name = token_symbol(parser_current_token(parser));
   if (!node->function_declaration.name) {
-    ast_destroy(node);
     return NULL;
   }
   parser_advance(parser);
 
   if (!parser_expect(parser, TOKEN_LPAREN,
                      "Expected '(' after function name")) {
-    ast_destroy(node);
     return NULL;
   }
 
-  node->function_declaration.param_names = malloc(sizeof(char *) * 100);
-  node->function_declaration.param_types = malloc(sizeof(char *) * 100);
-  node->function_declaration.param_defaults = malloc(sizeof(ASTNode *) * 100);
-  node->function_declaration.param_has_default = malloc(sizeof(bool) * 100);
-  
-  if (!node->function_declaration.param_names ||
-      !node->function_declaration.param_types ||
-      !node->function_declaration.param_defaults ||
-      !node->function_declaration.param_has_default) {
-    ast_destroy(node);
-    return NULL;
-  }
-
-  node->function_declaration.param_count = 0;
+  // Each parameter is pushed as a name, type and default value.
+  size_t base = parser->pending_count;
   bool found_default = false;
 
   if (parser_current_token(parser)->type != TOKEN_RPAREN) {
     do {
-      char *param_type = NULL;
+      const Type *param_type = NULL;
       char *param_name = NULL;
       ASTNode *default_value = NULL;
-      bool has_default = false;
 
       Token *first_token = parser_current_token(parser);
-      Token *second_token = NULL;
-      
-      if (parser->current + 1 < parser->token_count) {
-        second_token = &parser->tokens[parser->current + 1];
-      }
+      Token *second_token = parser_peek_token(parser);
 
       bool is_auto_typed = false;
       
-      if (first_token->type == TOKEN_IDENTIFIER && second_token &&
+      if (first_token->type == TOKEN_IDENTIFIER &&
           (second_token->type == TOKEN_ASSIGN || second_token->type == TOKEN_COMMA || 
            second_token->type == TOKEN_RPAREN)) {
         is_auto_typed = true;
@@ -590,80 +698,83 @@ static ASTNode *parser_parse_function_declaration(Parser *parser) {
 
       if (is_auto_typed) {
         param_type = NULL;
-        param_name = strdup(first_token->value);
+        param_name = token_text(parser, first_token);
         parser_advance(parser);
       } else {
         if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
           error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                        "Expected parameter type", "Use format: type name or just name for auto-typing");
-          ast_destroy(node);
           return NULL;
         }
 
-        param_type = strdup(parser_current_token(parser)->value);
+        param_type = type_intern(token_symbol(parser_current_token(parser)));
         parser_advance(parser);
 
         if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
           error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                        "Expected parameter name after type",
                        "Use format: type name");
-          free(param_type);
-          ast_destroy(node);
           return NULL;
         }
 
-        param_name = strdup(parser_current_token(parser)->value);
+        param_name = token_text(parser, parser_current_token(parser));
         parser_advance(parser);
       }
 
       if (parser_match(parser, TOKEN_ASSIGN)) {
-        has_default = true;
         found_default = true;
         default_value = parser_parse_expression(parser);
         if (!default_value) {
-          free(param_type);
-          free(param_name);
-          ast_destroy(node);
           return NULL;
         }
       } else if (found_default) {
         error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                      "Non-default parameter follows default parameter",
                      "All parameters after a default parameter must also have defaults");
-        free(param_type);
-        free(param_name);
-        ast_destroy(node);
         return NULL;
       }
 
-      node->function_declaration.param_types[node->function_declaration.param_count] = param_type;
-      node->function_declaration.param_names[node->function_declaration.param_count] = param_name;
-      node->function_declaration.param_defaults[node->function_declaration.param_count] = default_value;
-      node->function_declaration.param_has_default[node->function_declaration.param_count] = has_default;
-      node->function_declaration.param_count++;
+      if (!parser_list_push(parser, param_name) ||
+          !parser_list_push(parser, (void *)param_type) ||
+          !parser_list_push(parser, default_value)) {
+        return NULL;
+      }
 
     } while (parser_match(parser, TOKEN_COMMA));
   }
 
   if (!parser_expect(parser, TOKEN_RPAREN, "Expected ')' after parameters")) {
-    ast_destroy(node);
     return NULL;
   }
 
+  int param_count = parser_list_length(parser, base, 3);
+  node->function_declaration.param_count = param_count;
+  node->function_declaration.param_names = parser_list_column(parser, base, 3, 0);
+  node->function_declaration.param_types = parser_list_column(parser, base, 3, 1);
+  node->function_declaration.param_defaults = parser_list_column(parser, base, 3, 2);
+  node->function_declaration.param_has_default = arena_alloc(parser->arena, sizeof(bool) * param_count);
+  parser->pending_count = base;
+
+  if (!node->function_declaration.param_names ||
+      !node->function_declaration.param_types ||
+      !node->function_declaration.param_defaults ||
+      !node->function_declaration.param_has_default) {
+    return NULL;
+  }
+  for (int i = 0; i < param_count; i++) {
+    node->function_declaration.param_has_default[i] =
+        node->function_declaration.param_defaults[i] != NULL;
+  }
+
   if (parser_match(parser, TOKEN_ARROW)) {
     if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
       error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                    "Expected return type after '->'",
                    "Specify return type or remove '->'");
-      ast_destroy(node);
       return NULL;
     }
     node->function_declaration.return_type =
-        strdup(parser_current_token(parser)->value);
-    if (!node->function_declaration.return_type) {
-      ast_destroy(node);
-      return NULL;
-    }
+        type_intern(token_symbol(parser_current_token(parser)));
     parser_advance(parser);
   } else {
     node->function_declaration.return_type = NULL;
@@ -671,13 +782,11 @@ static ASTNode *parser_parse_function_declaration(Parser *parser) {
 
   if (!parser_expect(parser, TOKEN_LBRACE,
                      "Expected '{' before function body")) {
-    ast_destroy(node);
     return NULL;
   }
 
   node->function_declaration.body = parser_parse_block_statement(parser);
   if (!node->function_declaration.body) {
-    ast_destroy(node);
     return NULL;
   }
 
@@ -688,7 +797,7 @@ static ASTNode *parser_parse_return_statement(Parser *parser) {
   Token *token = parser_current_token(parser);
   parser_advance(parser); // consume 'return'
 
-  ASTNode *node = ast_create_node(AST_RETURN_STATEMENT, token->pos);
+  ASTNode *node = ast_create_node(parser, AST_RETURN_STATEMENT, token->pos);
 
   if (parser_current_token(parser)->type != TOKEN_SEMICOLON &&
       parser_current_token(parser)->type != TOKEN_RBRACE) {
@@ -710,8 +819,8 @@ static ASTNode *parser_parse_assignment_or_expression(Parser *parser) {
       parser_advance(parser); // skip '='
 
       ASTNode *assignment =
-          ast_create_node(AST_ASSIGNMENT_EXPRESSION, id_token->pos);
-      assignment->assignment_expression.name = strdup(id_token->value);
+          ast_create_node(parser, AST_ASSIGNMENT_EXPRESSION, id_token->pos);
+      assignment->assignment_expression.name = token_symbol(id_token);
       assignment->assignment_expression.value = parser_parse_expression(parser);
 
       return assignment;
@@ -725,14 +834,13 @@ static ASTNode *parser_parse_import_statement(Parser *parser) {
   Token *token = parser_current_token(parser);
   parser_advance(parser); // consume 'import'
 
-  ASTNode *node = ast_create_node(AST_IMPORT_STATEMENT, token->pos);
+  ASTNode *node = ast_create_node(parser, AST_IMPORT_STATEMENT, token->pos);
 
   parser_expect(parser, TOKEN_LBRACE, "Expected '{' after import");
 
   // Parse import list
-  node->import_statement.names = malloc(sizeof(char *) * 10);
-  node->import_statement.aliases = malloc(sizeof(char *) * 10);
-  node->import_statement.name_count = 0;
+  // Each entry is pushed as a name and its alias, if any.
+  size_t base = parser->pending_count;
 
   do {
     if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
@@ -743,7 +851,7 @@ static ASTNode *parser_parse_import_statement(Parser *parser) {
       return NULL;
     }
 
-    char *name = strdup(parser_current_token(parser)->value);
+    char *name = token_text(parser, parser_current_token(parser));
     parser_advance(parser);
 
     char *alias = NULL;
@@ -751,20 +859,27 @@ static ASTNode *parser_parse_import_statement(Parser *parser) {
       if (parser_current_token(parser)->type != TOKEN_IDENTIFIER) {
         error_report(ERROR_PARSER, parser_current_token(parser)->pos,
                      "Expected alias name after 'as'", "Provide an alias name");
-        free(name);
         parser_advance(parser);
         return NULL;
       }
-      alias = strdup(parser_current_token(parser)->value);
+      alias = token_text(parser, parser_current_token(parser));
       parser_advance(parser);
     }
 
-    node->import_statement.names[node->import_statement.name_count] = name;
-    node->import_statement.aliases[node->import_statement.name_count] = alias;
-    node->import_statement.name_count++;
+    if (!parser_list_push(parser, name) || !parser_list_push(parser, alias)) {
+      return NULL;
+    }
 
   } while (parser_match(parser, TOKEN_COMMA));
 
+  node->import_statement.name_count = parser_list_length(parser, base, 2);
+  node->import_statement.names = parser_list_column(parser, base, 2, 0);
+  node->import_statement.aliases = parser_list_column(parser, base, 2, 1);
+  parser->pending_count = base;
+  if (!node->import_statement.names || !node->import_statement.aliases) {
+    return NULL;
+  }
+
   parser_expect(parser, TOKEN_RBRACE, "Expected '}' after import list");
 
   parser_match(parser, TOKEN_SEMICOLON);
@@ -773,6 +888,7 @@ static ASTNode *parser_parse_import_statement(Parser *parser) {
 
 static ASTNode *parser_parse_statement(Parser *parser) {
   Token *token = parser_current_token(parser);
+  Position pos = token->pos; // The token itself is gone once the expression is parsed
 
   switch (token->type) {
   case TOKEN_KEYWORD_LET:
@@ -799,7 +915,7 @@ static ASTNode *parser_parse_statement(Parser *parser) {
     }
     ASTNode *expr = parser_parse_expression(parser);
     if (expr) {
-      ASTNode *stmt = ast_create_node(AST_EXPRESSION_STATEMENT, token->pos);
+      ASTNode *stmt = ast_create_node(parser, AST_EXPRESSION_STATEMENT, pos);
       stmt->expression_statement.expression = expr;
       parser_match(parser, TOKEN_SEMICOLON);
       return stmt;
@@ -810,7 +926,7 @@ static ASTNode *parser_parse_statement(Parser *parser) {
     // Expression statement
     ASTNode *expr = parser_parse_expression(parser);
     if (expr) {
-      ASTNode *stmt = ast_create_node(AST_EXPRESSION_STATEMENT, token->pos);
+      ASTNode *stmt = ast_create_node(parser, AST_EXPRESSION_STATEMENT, pos);
       stmt->expression_statement.expression = expr;
       parser_match(parser, TOKEN_SEMICOLON);
       return stmt;
@@ -821,15 +937,17 @@ static ASTNode *parser_parse_statement(Parser *parser) {
 }
 
 ASTNode *parser_parse(Parser *parser) {
-  ASTNode *program = ast_create_node(AST_PROGRAM, position_create(1, 1, ""));
-  program->program.statements = malloc(sizeof(ASTNode *) * 100);
-  program->program.statement_count = 0;
+  ASTNode *program = ast_create_node(parser, AST_PROGRAM, position_create(-1, 0));
+  size_t base = parser->pending_count;
 
   while (parser_current_token(parser)->type != TOKEN_EOF) {
+    size_t top = parser->pending_count;
     ASTNode *stmt = parser_parse_statement(parser);
     if (stmt) {
-      program->program.statements[program->program.statement_count++] = stmt;
+      if (!parser_list_push(parser, stmt))
+        return NULL;
     } else {
+      parser->pending_count = top; // Drop whatever the failed statement left
       // Skip to next statement on error
       while (parser_current_token(parser)->type != TOKEN_SEMICOLON &&
              parser_current_token(parser)->type != TOKEN_EOF &&
@@ -842,101 +960,13 @@ ASTNode *parser_parse(Parser *parser) {
     }
   }
 
+  program->program.statements = parser_list_finish(
+      parser, base, &program->program.statement_count);
+  if (!program->program.statements)
+    return NULL;
   return program;
 }
 
-void ast_destroy(ASTNode *node) {
-  if (!node)
-    return;
-
-  switch (node->type) {
-  case AST_PROGRAM:
-    for (int i = 0; i < node->program.statement_count; i++) {
-      ast_destroy(node->program.statements[i]);
-    }
-    free(node->program.statements);
-    break;
-  case AST_VARIABLE_DECLARATION:
-    free(node->variable_declaration.name);
-    free(node->variable_declaration.var_type);
-    ast_destroy(node->variable_declaration.initializer);
-    break;
-  case AST_FUNCTION_DECLARATION:
-    free(node->function_declaration.name);
-    for (int i = 0; i < node->function_declaration.param_count; i++) {
-      free(node->function_declaration.param_names[i]);
-      free(node->function_declaration.param_types[i]);
-      if (node->function_declaration.param_defaults[i]) {
-        ast_destroy(node->function_declaration.param_defaults[i]);
-      }
-    }
-    free(node->function_declaration.param_names);
-    free(node->function_declaration.param_types);
-    free(node->function_declaration.param_defaults);
-    free(node->function_declaration.param_has_default);
-    free(node->function_declaration.return_type);
-    ast_destroy(node->function_declaration.body);
-    break;
-  case AST_RETURN_STATEMENT:
-    ast_destroy(node->return_statement.expression);
-    break;
-  case AST_EXPRESSION_STATEMENT:
-    ast_destroy(node->expression_statement.expression);
-    break;
-  case AST_BLOCK_STATEMENT:
-    for (int i = 0; i < node->block_statement.statement_count; i++) {
-      ast_destroy(node->block_statement.statements[i]);
-    }
-    free(node->block_statement.statements);
-    break;
-  case AST_PRINT_STATEMENT:
-    ast_destroy(node->print_statement.expression);
-    break;
-  case AST_FUNCTION_CALL:
-    free(node->function_call.name);
-    for (int i = 0; i < node->function_call.argument_count; i++) {
-      ast_destroy(node->function_call.arguments[i]);
-    }
-    free(node->function_call.arguments);
-    break;
-  case AST_BINARY_EXPRESSION:
-    ast_destroy(node->binary_expression.left);
-    ast_destroy(node->binary_expression.right);
-    break;
-  case AST_UNARY_EXPRESSION:
-    ast_destroy(node->unary_expression.operand);
-    break;
-  case AST_IDENTIFIER:
-    free(node->identifier.name);
-    break;
-  case AST_LITERAL:
-    value_destroy(node->literal.value);
-    break;
-  case AST_FORMAT_STRING:
-    free(node->format_string.template);
-    for (int i = 0; i < node->format_string.expression_count; i++) {
-      ast_destroy(node->format_string.expressions[i]);
-    }
-    free(node->format_string.expressions);
-    break;
-  case AST_ASSIGNMENT_EXPRESSION:
-    free(node->assignment_expression.name);
-    ast_destroy(node->assignment_expression.value);
-    break;
-  case AST_IMPORT_STATEMENT:
-    for (int i = 0; i < node->import_statement.name_count; i++) {
-      free(node->import_statement.names[i]);
-      free(node->import_statement.aliases[i]);
-    }
-    free(node->import_statement.names);
-    free(node->import_statement.aliases);
-    free(node->import_statement.module_path);
-    break;
-  }
-
-  free(node->pos.filename);
-  free(node);
-}
 
 void ast_print(ASTNode *node, int indent) {
   if (!node)
@@ -953,9 +983,9 @@ void ast_print(ASTNode *node, int indent) {
     }
     break;
   case AST_VARIABLE_DECLARATION:
-    printf("VarDecl: %s", node->variable_declaration.name);
+    printf("VarDecl: %s", node->variable_declaration.name->name);
     if (node->variable_declaration.var_type) {
-      printf(" : %s", node->variable_declaration.var_type);
+      printf(" : %s", node->variable_declaration.var_type->name->name);
     }
     printf("\n");
     if (node->variable_declaration.initializer) {
@@ -963,7 +993,7 @@ void ast_print(ASTNode *node, int indent) {
     }
     break;
   case AST_FUNCTION_DECLARATION:
-    printf("FuncDecl: %s", node->function_declaration.name);
+    printf("FuncDecl: %s", node->function_declaration.name->name);
     if (node->function_declaration.is_public)
       printf(" (public)");
     printf("\n");
@@ -973,13 +1003,15 @@ void ast_print(ASTNode *node, int indent) {
     for (int i = 0; i < node->function_declaration.param_count; i++) {
       for (int j = 0; j < indent + 2; j++)
         printf("  ");
-      printf("%s %s\n", node->function_declaration.param_types[i],
+      const Type *type = node->function_declaration.param_types[i];
+      printf("%s %s\n", type ? type->name->name : "auto",
              node->function_declaration.param_names[i]);
     }
     if (node->function_declaration.return_type) {
       for (int i = 0; i < indent + 1; i++)
         printf("  ");
-      printf("Returns: %s\n", node->function_declaration.return_type);
+      printf("Returns: %s\n",
+             node->function_declaration.return_type->name->name);
     }
     ast_print(node->function_declaration.body, indent + 1);
     break;
@@ -1004,7 +1036,7 @@ void ast_print(ASTNode *node, int indent) {
     ast_print(node->print_statement.expression, indent + 1);
     break;
   case AST_FUNCTION_CALL:
-    printf("Call: %s (%d args)\n", node->function_call.name,
+    printf("Call: %s (%d args)\n", node->function_call.name->name,
            node->function_call.argument_count);
     for (int i = 0; i < node->function_call.argument_count; i++) {
       ast_print(node->function_call.arguments[i], indent + 1);
@@ -1022,7 +1054,7 @@ void ast_print(ASTNode *node, int indent) {
     ast_print(node->unary_expression.operand, indent + 1);
     break;
   case AST_IDENTIFIER:
-    printf("Identifier: %s\n", node->identifier.name);
+    printf("Identifier: %s\n", node->identifier.name->name);
     break;
   case AST_LITERAL:
     printf("Literal: ");
@@ -1037,7 +1069,7 @@ void ast_print(ASTNode *node, int indent) {
     }
     break;
   case AST_ASSIGNMENT_EXPRESSION:
-    printf("Assignment: %s\n", node->assignment_expression.name);
+    printf("Assignment: %s\n", node->assignment_expression.name->name);
     ast_print(node->assignment_expression.value, indent + 1);
     break;
   case AST_IMPORT_STATEMENT:
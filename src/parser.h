@@ -3,6 +3,25 @@
 
 #include "lexer.h"
 #include "value.h"
+#include "symbol.h"
+#include "environment.h"
+#include "arena.h"
+
+// A piece of a format string's template. Slices point into the template
+// and are not NUL-terminated.
+typedef struct {
+    const char *text;
+    size_t length;
+} FormatSlice;
+
+// A format string split once, at parse time, around its placeholders.
+// Rendering n values writes literals[0], value 0, literals[1], ...,
+// value n-1, literals[n].
+typedef struct FormatTemplate {
+    FormatSlice *literals;      // One more than there are placeholders
+    FormatSlice *placeholders;  // "${...}" as written, shown when a value is missing
+    size_t literal_length;      // Total length of the literals
+} FormatTemplate;
 
 typedef enum {
     AST_PROGRAM,
@@ -22,6 +41,18 @@ typedef enum {
     AST_ASSIGNMENT_EXPRESSION
 } ASTNodeType;
 
+// Operand types a binary expression has settled on, in the style of a
+// self-specializing AST. A site starts out unspecialized; its first
+// evaluation rewrites it to the fast path for the types it saw, guarded by
+// a type check. When the guard fails the site falls back to the generic
+// path for good, so a site that sees mixed types stops paying for guesses.
+typedef enum {
+    BINARY_UNSPECIALIZED,
+    BINARY_INT,             // int op int, for + - * % and //
+    BINARY_FLOAT,           // float op float, for + - * and /
+    BINARY_GENERIC          // Anything else: interpreter_binary_operation
+} BinarySpecialization;
+
 typedef struct ASTNode {
     ASTNodeType type;
     Position pos;
@@ -32,27 +63,30 @@ typedef struct ASTNode {
         } program;
         
         struct {
-            char *name;
-            char *var_type;
+            Symbol *name;
+            const Type *var_type;   // NULL when the declaration has no annotation
             struct ASTNode *initializer;
             bool is_fixed;
+            int slot;               // Set by the resolver; -1 for dynamic scopes
         } variable_declaration;
         
         struct {
-            char *name;
+            Symbol *name;
             struct ASTNode *value;
+            EnvSlot where;
         } assignment_expression;
         
         struct {
-            char *name;
+            Symbol *name;
             char **param_names;
-            char **param_types;
+            const Type **param_types;
             int param_count;
             struct ASTNode **param_defaults;
             bool *param_has_default;
-            char *return_type;
+            const Type *return_type;
             struct ASTNode *body;
             bool is_public;
+            int slot;               // Set by the resolver; -1 for dynamic scopes
         } function_declaration;
         
         struct {
@@ -66,6 +100,9 @@ typedef struct ASTNode {
         struct {
             struct ASTNode **statements;
             int statement_count;
+            int scope_size;         // Slots declared in this block, from the resolver
+            bool needs_scope;       // False if the block declares nothing and
+                                    // runs in the enclosing scope
         } block_statement;
         
         struct {
@@ -74,15 +111,18 @@ typedef struct ASTNode {
         } print_statement;
         
         struct {
-            char *name;
+            Symbol *name;
             struct ASTNode **arguments;
             int argument_count;
+            EnvSlot where;
+            CallCache cache;
         } function_call;
         
         struct {
             struct ASTNode *left;
             TokenType operator;
             struct ASTNode *right;
+            BinarySpecialization specialization;  // Rewritten by the tree walker
         } binary_expression;
         
         struct {
@@ -91,11 +131,12 @@ typedef struct ASTNode {
         } unary_expression;
         
         struct {
-            char *name;
+            Symbol *name;
+            EnvSlot where;
         } identifier;
         
         struct {
-            Value *value;
+            Value value;
         } literal;
         struct {
             char **names;
@@ -106,6 +147,7 @@ typedef struct ASTNode {
         
         struct {
             char *template;
+            FormatTemplate segments;
             struct ASTNode **expressions;
             int expression_count;
         } format_string;
@@ -119,16 +161,29 @@ typedef struct ASTNode {
     };
 } ASTNode;
 
+// The parser pulls tokens from its lexer as it needs them and keeps only a
+// small ring of lookahead, so memory does not grow with the size of the
+// file. A token pointer from the ring stays valid for the next
+// PARSER_LOOKAHEAD - 2 advances; copy anything needed for longer.
+#define PARSER_LOOKAHEAD 8
+
 typedef struct {
-    Token *tokens;
-    size_t token_count;
-    size_t current;
+    Lexer *lexer;                        // Borrowed
+    Arena *arena;                        // Borrowed; owns every node parsed
+    Token lookahead[PARSER_LOOKAHEAD];
+    size_t current;                      // Stream index of the current token
+    size_t filled;                       // Tokens pulled from the lexer so far
+    void **pending;                      // Children of unfinished lists, innermost last
+    size_t pending_count;
+    size_t pending_capacity;
 } Parser;
 
-Parser *parser_create(Token *tokens, size_t token_count);
+// Every node, child array and string of the tree is allocated from `arena`.
+// The tree has no other owner: it lives until the caller destroys the
+// arena, which must outlast any function declared by the code.
+Parser *parser_create(Lexer *lexer, Arena *arena);
 void parser_destroy(Parser *parser);
 ASTNode *parser_parse(Parser *parser);
-void ast_destroy(ASTNode *node);
 void ast_print(ASTNode *node, int indent);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "pool.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LIZARD_NO_POOL
+
+void *pool_alloc(size_t size) {
+    return malloc(size);
+}
+
+void pool_free(void *memory, size_t size) {
+    (void)size;
+    free(memory);
+}
+
+void *pool_realloc(void *memory, size_t old_size, size_t new_size) {
+    (void)old_size;
+    return realloc(memory, new_size);
+}
+
+#else
+
+#define POOL_GRAIN 16
+#define POOL_CLASSES (POOL_MAX_SIZE / POOL_GRAIN)
+#define POOL_SLAB_SIZE (64 * 1024)
+
+// Under AddressSanitizer, blocks on a free list are poisoned so a use
+// after free is still caught, although only until the block is reused.
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define POOL_POISON(memory, size) ASAN_POISON_MEMORY_REGION(memory, size)
+#define POOL_UNPOISON(memory, size) ASAN_UNPOISON_MEMORY_REGION(memory, size)
+#else
+#define POOL_POISON(memory, size) ((void)(memory), (void)(size))
+#define POOL_UNPOISON(memory, size) ((void)(memory), (void)(size))
+#endif
+
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+} PoolBlock;
+
+typedef struct {
+    PoolBlock *free;        // Blocks handed back by pool_free
+    char *carve;            // Untouched tail of the newest slab
+    char *carve_end;
+} PoolClass;
+
+static PoolClass classes[POOL_CLASSES];
+
+static inline int pool_class(size_t size) {
+    return (int)((size ? size - 1 : 0) / POOL_GRAIN);
+}
+
+// Slabs live until exit. They are never walked, since every block in
+// them is reachable from a free list or from whoever allocated it.
+static bool pool_refill(PoolClass *class, size_t block_size) {
+    char *slab = malloc(POOL_SLAB_SIZE);
+    if (!slab) return false;
+
+    class->carve = slab;
+    class->carve_end = slab + POOL_SLAB_SIZE - POOL_SLAB_SIZE % block_size;
+    POOL_POISON(slab, POOL_SLAB_SIZE);
+    return true;
+}
+
+void *pool_alloc(size_t size) {
+    if (size > POOL_MAX_SIZE) return malloc(size);
+
+    int index = pool_class(size);
+    size_t block_size = (size_t)(index + 1) * POOL_GRAIN;
+    PoolClass *class = &classes[index];
+
+    PoolBlock *block = class->free;
+    if (block) {
+        POOL_UNPOISON(block, block_size);
+        class->free = block->next;
+        return block;
+    }
+
+    if (class->carve == class->carve_end && !pool_refill(class, block_size)) {
+        return NULL;
+    }
+    void *memory = class->carve;
+    class->carve += block_size;
+    POOL_UNPOISON(memory, block_size);
+    return memory;
+}
+
+void pool_free(void *memory, size_t size) {
+    if (!memory) return;
+    if (size > POOL_MAX_SIZE) {
+        free(memory);
+        return;
+    }
+
+    int index = pool_class(size);
+    PoolBlock *block = memory;
+    block->next = classes[index].free;
+    classes[index].free = block;
+    POOL_POISON(block, (size_t)(index + 1) * POOL_GRAIN);
+}
+
+void *pool_realloc(void *memory, size_t old_size, size_t new_size) {
+    if (!memory) return pool_alloc(new_size);
+    if (old_size > POOL_MAX_SIZE && new_size > POOL_MAX_SIZE) {
+        return realloc(memory, new_size);
+    }
+    if (old_size <= POOL_MAX_SIZE && new_size <= POOL_MAX_SIZE &&
+        pool_class(old_size) == pool_class(new_size)) {
+        return memory;
+    }
+
+    void *moved = pool_alloc(new_size);
+    if (!moved) return NULL;
+    memcpy(moved, memory, old_size < new_size ? old_size : new_size);
+    pool_free(memory, old_size);
+    return moved;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Free lists for the small objects the runtime creates and drops all the
+// time: strings, functions and heap scopes. Requests are rounded up to a
+// multiple of 16 bytes, and each size class has its own free list backed
+// by 64KB slabs. A freed block goes back on its list for the next request
+// of that class and is never returned to malloc. Requests over
+// POOL_MAX_SIZE go straight to malloc.
+//
+// The caller passes the size back when freeing, since blocks carry no
+// header. Building with POOL=0 (-DLIZARD_NO_POOL) makes every call plain
+// malloc/free, so AddressSanitizer can check each object by itself.
+#define POOL_MAX_SIZE 256
+
+void *pool_alloc(size_t size);
+void pool_free(void *memory, size_t size);
+// Moves the block to the size class for `new_size`, keeping the first
+// min(old_size, new_size) bytes.
+void *pool_realloc(void *memory, size_t old_size, size_t new_size);
+
+#endif
@@ -0,0 +1,180 @@
+#include "resolver.h"
+#include <stdlib.h>
+
+typedef struct Scope {
+  Symbol **names;          // Indexed by slot
+  int count;
+  int capacity;
+  struct Scope *enclosing; // NULL past the innermost function boundary
+} Scope;
+
+static void resolve_node(Scope *scope, ASTNode *node);
+
+static int scope_find(Scope *scope, Symbol *name) {
+  for (int slot = 0; slot < scope->count; slot++) {
+    if (scope->names[slot] == name)
+      return slot;
+  }
+  return -1;
+}
+
+static int scope_append(Scope *scope, Symbol *name) {
+  if (scope->count >= scope->capacity) {
+    scope->capacity = scope->capacity ? scope->capacity * 2 : 8;
+    scope->names = realloc(scope->names, sizeof(Symbol *) * scope->capacity);
+  }
+  scope->names[scope->count] = name;
+  return scope->count++;
+}
+
+// Redeclaring a name in the same scope is a runtime error that leaves the
+// first binding in place, so it maps to the slot that binding already has.
+static int scope_declare(Scope *scope, Symbol *name) {
+  int slot = scope_find(scope, name);
+  return slot >= 0 ? slot : scope_append(scope, name);
+}
+
+static EnvSlot resolve_name(Scope *scope, Symbol *name) {
+  for (int depth = 0; scope; scope = scope->enclosing, depth++) {
+    int slot = scope_find(scope, name);
+    if (slot >= 0) {
+      EnvSlot where = {depth, slot};
+      return where;
+    }
+  }
+  return ENV_SLOT_DYNAMIC;
+}
+
+// Only statements directly inside a block bind names in its scope; nested
+// blocks and function bodies get scopes of their own.
+static bool block_declares(ASTNode *block) {
+  for (int i = 0; i < block->block_statement.statement_count; i++) {
+    ASTNodeType type = block->block_statement.statements[i]->type;
+    if (type == AST_VARIABLE_DECLARATION || type == AST_FUNCTION_DECLARATION)
+      return true;
+  }
+  return false;
+}
+
+static void resolve_function(Scope *scope, ASTNode *node) {
+  if (scope) {
+    node->function_declaration.slot =
+        scope_declare(scope, node->function_declaration.name);
+  }
+
+  // Default arguments are evaluated in the caller's scope, which is unknown.
+  for (int i = 0; i < node->function_declaration.param_count; i++) {
+    if (node->function_declaration.param_has_default[i]) {
+      resolve_node(NULL, node->function_declaration.param_defaults[i]);
+    }
+  }
+
+  // Parameter i is always bound at slot i. A repeated parameter name keeps
+  // the first binding, which is also what lookups of that name find.
+  Scope params = {NULL, 0, 0, NULL};
+  for (int i = 0; i < node->function_declaration.param_count; i++) {
+    scope_append(&params,
+                 symbol_intern(node->function_declaration.param_names[i]));
+  }
+
+  resolve_node(&params, node->function_declaration.body);
+  free(params.names);
+}
+
+static void resolve_node(Scope *scope, ASTNode *node) {
+  if (!node)
+    return;
+
+  switch (node->type) {
+  case AST_PROGRAM:
+    for (int i = 0; i < node->program.statement_count; i++) {
+      resolve_node(NULL, node->program.statements[i]);
+    }
+    break;
+
+  case AST_VARIABLE_DECLARATION:
+    // The initializer runs before the name exists, so it sees outer bindings.
+    resolve_node(scope, node->variable_declaration.initializer);
+    if (scope) {
+      node->variable_declaration.slot =
+          scope_declare(scope, node->variable_declaration.name);
+    }
+    break;
+
+  case AST_FUNCTION_DECLARATION:
+    resolve_function(scope, node);
+    break;
+
+  case AST_RETURN_STATEMENT:
+    resolve_node(scope, node->return_statement.expression);
+    break;
+
+  case AST_EXPRESSION_STATEMENT:
+    resolve_node(scope, node->expression_statement.expression);
+    break;
+
+  case AST_BLOCK_STATEMENT: {
+    if (!block_declares(node)) {
+      // Nothing can bind here, so the block shares its enclosing scope and
+      // adds no depth to the names resolved inside it.
+      node->block_statement.needs_scope = false;
+      node->block_statement.scope_size = 0;
+      for (int i = 0; i < node->block_statement.statement_count; i++) {
+        resolve_node(scope, node->block_statement.statements[i]);
+      }
+      break;
+    }
+
+    Scope block = {NULL, 0, 0, scope};
+    for (int i = 0; i < node->block_statement.statement_count; i++) {
+      resolve_node(&block, node->block_statement.statements[i]);
+    }
+    node->block_statement.scope_size = block.count;
+    free(block.names);
+    break;
+  }
+
+  case AST_PRINT_STATEMENT:
+    resolve_node(scope, node->print_statement.expression);
+    break;
+
+  case AST_FUNCTION_CALL:
+    for (int i = 0; i < node->function_call.argument_count; i++) {
+      resolve_node(scope, node->function_call.arguments[i]);
+    }
+    node->function_call.where = resolve_name(scope, node->function_call.name);
+    break;
+
+  case AST_BINARY_EXPRESSION:
+    resolve_node(scope, node->binary_expression.left);
+    resolve_node(scope, node->binary_expression.right);
+    break;
+
+  case AST_UNARY_EXPRESSION:
+    resolve_node(scope, node->unary_expression.operand);
+    break;
+
+  case AST_IDENTIFIER:
+    node->identifier.where = resolve_name(scope, node->identifier.name);
+    break;
+
+  case AST_FORMAT_STRING:
+    for (int i = 0; i < node->format_string.expression_count; i++) {
+      resolve_node(scope, node->format_string.expressions[i]);
+    }
+    break;
+
+  case AST_ASSIGNMENT_EXPRESSION:
+    resolve_node(scope, node->assignment_expression.value);
+    node->assignment_expression.where =
+        resolve_name(scope, node->assignment_expression.name);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void resolver_resolve(ASTNode *program) {
+  resolve_node(NULL, program);
+}
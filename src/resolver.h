@@ -0,0 +1,14 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "parser.h"
+
+// Runs after parser_parse. Gives every name declared inside a function or
+// block a fixed slot in its scope, and annotates identifiers, assignments
+// and calls that refer to such a name with the (depth, slot) to read at
+// runtime. Names declared at the top level of a program, and names a
+// function does not bind itself, are left to dynamic lookup: a function's
+// scope chains to its caller's, so they cannot be fixed statically.
+void resolver_resolve(ASTNode *program);
+
+#endif
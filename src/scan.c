@@ -0,0 +1,133 @@
+#include "scan.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    SCAN_WHITESPACE,
+    SCAN_NEWLINE,
+    SCAN_HASH,
+    SCAN_QUOTE
+} ScanKind;
+
+// One vector of bytes is compared at a time and the comparisons are reduced
+// to bit masks, bit i standing for byte i. The intrinsics differ only in
+// width, so the kernel below is written once against these macros.
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_WIDTH 32
+#define SCAN_ALL_BITS 0xFFFFFFFFu
+typedef __m256i ScanVector;
+#define scan_load(p)     _mm256_loadu_si256((const __m256i *)(p))
+#define scan_splat(c)    _mm256_set1_epi8((char)(c))
+#define scan_eq(a, b)    _mm256_cmpeq_epi8(a, b)
+#define scan_or(a, b)    _mm256_or_si256(a, b)
+#define scan_sub(a, b)   _mm256_sub_epi8(a, b)
+#define scan_min(a, b)   _mm256_min_epu8(a, b)
+#define scan_bits(v)     ((uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_WIDTH 16
+#define SCAN_ALL_BITS 0xFFFFu
+typedef __m128i ScanVector;
+#define scan_load(p)     _mm_loadu_si128((const __m128i *)(p))
+#define scan_splat(c)    _mm_set1_epi8((char)(c))
+#define scan_eq(a, b)    _mm_cmpeq_epi8(a, b)
+#define scan_or(a, b)    _mm_or_si128(a, b)
+#define scan_sub(a, b)   _mm_sub_epi8(a, b)
+#define scan_min(a, b)   _mm_min_epu8(a, b)
+#define scan_bits(v)     ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+#ifdef SCAN_WIDTH
+static inline void scan_block(const char *p, ScanKind kind, char quote,
+                              uint32_t *stop, uint32_t *newline) {
+    ScanVector bytes = scan_load(p);
+    *newline = scan_bits(scan_eq(bytes, scan_splat('\n')));
+
+    switch (kind) {
+        case SCAN_WHITESPACE: {
+            // '\t' through '\r' are contiguous, so one unsigned range check
+            // covers them: subtract '\t' and see whether min() leaves it be.
+            ScanVector control = scan_sub(bytes, scan_splat('\t'));
+            ScanVector in_range = scan_eq(scan_min(control, scan_splat('\r' - '\t')), control);
+            ScanVector space = scan_or(in_range, scan_eq(bytes, scan_splat(' ')));
+            *stop = ~scan_bits(space) & SCAN_ALL_BITS;
+            break;
+        }
+        case SCAN_NEWLINE:
+            *stop = *newline;
+            break;
+        case SCAN_HASH:
+            *stop = scan_bits(scan_eq(bytes, scan_splat('#')));
+            break;
+        case SCAN_QUOTE:
+            *stop = scan_bits(scan_or(scan_eq(bytes, scan_splat(quote)),
+                                      scan_eq(bytes, scan_splat('\\'))));
+            break;
+    }
+}
+
+// Appends the line starting after each newline in `newline`, a mask over
+// the block at `base`.
+static inline void scan_record_lines(LineTable *lines, uint32_t newline, size_t base) {
+    if (!newline) return;
+    line_table_reserve(lines, lines->count + (size_t)__builtin_popcount(newline));
+    do {
+        lines->starts[lines->count++] = (uint32_t)(base + (size_t)__builtin_ctz(newline) + 1);
+        newline &= newline - 1;
+    } while (newline);
+}
+#endif
+
+static inline bool scan_stops(ScanKind kind, char quote, char c) {
+    switch (kind) {
+        case SCAN_WHITESPACE: return !(c == ' ' || (c >= '\t' && c <= '\r'));
+        case SCAN_NEWLINE:    return c == '\n';
+        case SCAN_HASH:       return c == '#';
+        case SCAN_QUOTE:      return c == quote || c == '\\';
+    }
+    return true;
+}
+
+static inline size_t scan(const char *text, size_t pos, size_t length,
+                          ScanKind kind, char quote, LineTable *lines) {
+#ifdef SCAN_WIDTH
+    while (pos + SCAN_WIDTH <= length) {
+        uint32_t stop, newline;
+        scan_block(text + pos, kind, quote, &stop, &newline);
+        if (stop) {
+            unsigned offset = (unsigned)__builtin_ctz(stop);
+            scan_record_lines(lines, newline & ((1u << offset) - 1), pos);
+            return pos + offset;
+        }
+        scan_record_lines(lines, newline, pos);
+        pos += SCAN_WIDTH;
+    }
+#endif
+
+    for (; pos < length; pos++) {
+        char c = text[pos];
+        if (scan_stops(kind, quote, c)) return pos;
+        if (c == '\n') line_table_add(lines, pos + 1);
+    }
+    return length;
+}
+
+size_t scan_skip_whitespace(const char *text, size_t from, size_t length,
+                            LineTable *lines) {
+    return scan(text, from, length, SCAN_WHITESPACE, 0, lines);
+}
+
+size_t scan_find_newline(const char *text, size_t from, size_t length) {
+    return scan(text, from, length, SCAN_NEWLINE, 0, NULL);
+}
+
+size_t scan_find_hash(const char *text, size_t from, size_t length,
+                      LineTable *lines) {
+    return scan(text, from, length, SCAN_HASH, 0, lines);
+}
+
+size_t scan_find_quote(const char *text, size_t from, size_t length,
+                       char quote, LineTable *lines) {
+    return scan(text, from, length, SCAN_QUOTE, quote, lines);
+}
@@ -0,0 +1,199 @@
+#include "source.h"
+#include "symbol.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+static bool source_read_all(int fd, SourceText *source) {
+  size_t capacity = 4096, length = 0;
+  char *text = malloc(capacity);
+  if (!text)
+    return false;
+
+  for (;;) {
+    if (length == capacity) {
+      char *grown = realloc(text, capacity * 2);
+      if (!grown) {
+        free(text);
+        return false;
+      }
+      text = grown;
+      capacity *= 2;
+    }
+
+    ssize_t got = read(fd, text + length, capacity - length);
+    if (got < 0) {
+      free(text);
+      return false;
+    }
+    if (got == 0)
+      break;
+    length += (size_t)got;
+  }
+
+  source->text = text;
+  source->length = length;
+  source->mapped = false;
+  return true;
+}
+
+bool source_load(const char *path, SourceText *source) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+#ifndef _WIN32
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *text = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text != MAP_FAILED) {
+      // The lexer reads front to back exactly once.
+      posix_madvise(text, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+      close(fd);
+      source->text = text;
+      source->length = (size_t)st.st_size;
+      source->mapped = true;
+      return true;
+    }
+  }
+#endif
+
+  bool ok = source_read_all(fd, source);
+  close(fd);
+  return ok;
+}
+
+void source_release(SourceText *source) {
+#ifndef _WIN32
+  if (source->mapped) {
+    munmap((void *)source->text, source->length);
+    source->text = NULL;
+    return;
+  }
+#endif
+  free((void *)source->text);
+  source->text = NULL;
+}
+
+// Entries belong to the table and live as long as the process, since any
+// position kept in a tree or a compiled chunk may name them. Only lexers
+// over a whole buffer register one; see position_for_file for the rest.
+typedef struct {
+  const char *name;  // Interned, so buffers lexed under one name share it
+  LineTable lines;
+  bool name_only;    // From position_for_file: no buffer, no lines
+} SourceFile;
+
+typedef struct {
+  SourceFile **entries;  // Indexed by file id; entries never move
+  int count;
+  int capacity;
+} FileTable;
+
+static FileTable files;
+
+int source_file_register(const char *name) {
+  if (files.count >= files.capacity) {
+    files.capacity = files.capacity ? files.capacity * 2 : 8;
+    files.entries = realloc(files.entries, sizeof(SourceFile *) * files.capacity);
+  }
+
+  SourceFile *file = calloc(1, sizeof(SourceFile));
+  file->name = symbol_intern(name)->name;
+  line_table_add(&file->lines, 0);
+
+  files.entries[files.count] = file;
+  return files.count++;
+}
+
+static SourceFile *source_file_get(int file_id) {
+  if (file_id < 0 || file_id >= files.count)
+    return NULL;
+  return files.entries[file_id];
+}
+
+const char *source_file_name(int file_id) {
+  SourceFile *file = source_file_get(file_id);
+  return file ? file->name : NULL;
+}
+
+LineTable *source_file_lines(int file_id) {
+  SourceFile *file = source_file_get(file_id);
+  return file ? &file->lines : NULL;
+}
+
+void line_table_reserve(LineTable *lines, size_t needed) {
+  if (needed <= lines->capacity)
+    return;
+
+  size_t capacity = lines->capacity ? lines->capacity : 64;
+  while (capacity < needed)
+    capacity *= 2;
+  lines->starts = realloc(lines->starts, sizeof(uint32_t) * capacity);
+  lines->capacity = capacity;
+}
+
+Position position_create(int file, size_t offset) {
+  Position pos;
+  pos.offset = (uint32_t)offset;
+  pos.file = file;
+  return pos;
+}
+
+// Whole-file positions, reported for imports that fail before lexing, need
+// only the name, so one entry per name serves every report.
+Position position_for_file(const char *name) {
+  const char *interned = symbol_intern(name)->name;
+  for (int i = 0; i < files.count; i++) {
+    if (files.entries[i]->name_only && files.entries[i]->name == interned) {
+      return position_create(i, POSITION_NO_OFFSET);
+    }
+  }
+
+  int file = source_file_register(name);
+  files.entries[file]->name_only = true;
+  return position_create(file, POSITION_NO_OFFSET);
+}
+
+const char *position_filename(Position pos) {
+  return source_file_name(pos.file);
+}
+
+// Index of the line holding `offset`, counting from 0: the number of line
+// starts at or before it, less one.
+static size_t position_line_index(const LineTable *lines, uint32_t offset) {
+  size_t low = 0, high = lines->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (lines->starts[mid] <= offset)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low - 1;
+}
+
+int position_line(Position pos) {
+  if (pos.offset == POSITION_NO_OFFSET)
+    return 0;
+
+  LineTable *lines = source_file_lines(pos.file);
+  if (!lines)
+    return 1;
+  return (int)position_line_index(lines, pos.offset) + 1;
+}
+
+int position_column(Position pos) {
+  if (pos.offset == POSITION_NO_OFFSET)
+    return 0;
+
+  LineTable *lines = source_file_lines(pos.file);
+  if (!lines)
+    return (int)pos.offset + 1;
+  return (int)(pos.offset - lines->starts[position_line_index(lines, pos.offset)]) + 1;
+}
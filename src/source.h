@@ -0,0 +1,68 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The text of a script or module. Regular files are mapped read-only, so
+// loading costs no copy and the pages are shared with the page cache; pipes
+// such as /dev/stdin, empty files and platforms without mmap fall back to a
+// heap buffer. The text is not NUL-terminated when mapped: use `length`.
+typedef struct {
+  const char *text;
+  size_t length;
+  bool mapped;
+} SourceText;
+
+// Returns false if the file cannot be opened or read.
+bool source_load(const char *path, SourceText *source);
+void source_release(SourceText *source);
+
+// Table of every source buffer the lexer has seen. Each buffer gets its own
+// id for the lifetime of the process along with the offsets where its lines
+// start, so a position only needs a byte offset and an id. Buffers lexed
+// under the same name, such as REPL lines, share one stored copy of the
+// name. Text inside a buffer, such as a format string placeholder, is
+// lexed under the buffer's own id rather than registered again.
+typedef struct {
+  uint32_t *starts;  // starts[i] is the offset of line i + 1; starts[0] == 0
+  size_t count;
+  size_t capacity;
+} LineTable;
+
+// A source location. Line and column are derived from the file's line table
+// only when a position is reported.
+typedef struct {
+  uint32_t offset;   // Byte offset into the file, or POSITION_NO_OFFSET
+  int file;          // Source file id, -1 for none
+} Position;
+
+// Positions that name a whole file, or nothing at all, report line 0,
+// column 0.
+#define POSITION_NO_OFFSET UINT32_MAX
+#define POSITION_NONE ((Position){POSITION_NO_OFFSET, -1})
+
+// Sources larger than this cannot be addressed by a 32-bit offset.
+#define SOURCE_MAX_LENGTH ((size_t)UINT32_MAX - 1)
+
+int source_file_register(const char *name);
+const char *source_file_name(int file_id);
+LineTable *source_file_lines(int file_id);
+
+// Makes room for at least `needed` line starts.
+void line_table_reserve(LineTable *lines, size_t needed);
+
+static inline void line_table_add(LineTable *lines, size_t start) {
+  if (lines->count >= lines->capacity)
+    line_table_reserve(lines, lines->count + 1);
+  lines->starts[lines->count++] = (uint32_t)start;
+}
+
+Position position_create(int file, size_t offset);
+Position position_for_file(const char *name);
+const char *position_filename(Position pos);
+int position_line(Position pos);
+int position_column(Position pos);
+
+#endif
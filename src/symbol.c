@@ -0,0 +1,76 @@
+#include "symbol.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  Symbol **slots;    // Open addressing, linear probing; NULL marks a free slot
+  size_t count;
+  size_t capacity;   // Always a power of two
+} SymbolTable;
+
+static SymbolTable symbols;
+
+uint32_t symbol_hash(const char *name, size_t length) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void symbol_table_grow(void) {
+  size_t capacity = symbols.capacity ? symbols.capacity * 2 : 256;
+  Symbol **slots = calloc(capacity, sizeof(Symbol *));
+
+  for (size_t i = 0; i < symbols.capacity; i++) {
+    Symbol *symbol = symbols.slots[i];
+    if (!symbol)
+      continue;
+
+    size_t index = symbol->hash & (capacity - 1);
+    while (slots[index]) {
+      index = (index + 1) & (capacity - 1);
+    }
+    slots[index] = symbol;
+  }
+
+  free(symbols.slots);
+  symbols.slots = slots;
+  symbols.capacity = capacity;
+}
+
+Symbol *symbol_intern_length(const char *name, size_t length) {
+  if ((symbols.count + 1) * 4 > symbols.capacity * 3) {
+    symbol_table_grow();
+  }
+
+  uint32_t hash = symbol_hash(name, length);
+  size_t index = hash & (symbols.capacity - 1);
+
+  while (symbols.slots[index]) {
+    Symbol *symbol = symbols.slots[index];
+    if (symbol->hash == hash && symbol->length == length &&
+        memcmp(symbol->name, name, length) == 0) {
+      return symbol;
+    }
+    index = (index + 1) & (symbols.capacity - 1);
+  }
+
+  Symbol *symbol = malloc(sizeof(Symbol));
+  symbol->name = malloc(length + 1);
+  memcpy(symbol->name, name, length);
+  symbol->name[length] = '\0';
+  symbol->length = length;
+  symbol->hash = hash;
+  symbol->version = 0;
+
+  symbols.slots[index] = symbol;
+  symbols.count++;
+  return symbol;
+}
+
+Symbol *symbol_intern(const char *name) {
+  return symbol_intern_length(name, strlen(name));
+}
@@ -0,0 +1,22 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interned identifier. Every distinct name maps to exactly one Symbol for
+// the lifetime of the process, so names compare by pointer and the hash is
+// computed once, at interning time.
+typedef struct Symbol {
+    char *name;
+    size_t length;
+    uint32_t hash;
+    uint64_t version;   // Bumped whenever a binding of this name changes
+} Symbol;
+
+Symbol *symbol_intern(const char *name);
+Symbol *symbol_intern_length(const char *name, size_t length);
+// The hash symbols are interned under; string values hash the same way.
+uint32_t symbol_hash(const char *name, size_t length);
+
+#endif
@@ -1,138 +1,109 @@
 #include "value.h"
+#include "pool.h"
 
-Value *value_create_int(int val) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_INT;
-  value->int_val = val;
-  return value;
-}
-
-Value *value_create_float(double val) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_FLOAT;
-  value->float_val = val;
-  return value;
-}
-
-Value *value_create_string(const char *val) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_STRING;
-  value->string_val = strdup(val);
-  return value;
-}
-
-Value *value_create_bool(bool val) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_BOOL;
-  value->bool_val = val;
-  return value;
+Value value_create_string(const char *val) {
+  return value_from_string(string_create(val, strlen(val)));
 }
 
-Value *value_create_function(Function *func) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_FUNCTION;
-  value->function_val = func;
+Value value_from_string(String *string) {
+  Value value;
+  value.type = VALUE_STRING;
+  value.string_val = string;
   return value;
 }
 
-Value *value_create_null(void) {
-  Value *value = malloc(sizeof(Value));
-  value->type = VALUE_NULL;
+Value value_create_function(Function *func) {
+  Value value;
+  value.type = VALUE_FUNCTION;
+  value.function_val = func;
   return value;
 }
 
-void value_destroy(Value *value) {
-  if (!value)
-    return;
-
-  switch (value->type) {
+void value_destroy(Value value) {
+  switch (value.type) {
   case VALUE_STRING:
-    free(value->string_val);
+    string_release(value.string_val);
     break;
   case VALUE_FUNCTION:
-    function_destroy(value->function_val);
+    function_release(value.function_val);
     break;
   default:
     break;
   }
-  free(value);
 }
 
-Value *value_copy(Value *value) {
-  if (!value)
-    return NULL;
-
-  switch (value->type) {
-  case VALUE_INT:
-    return value_create_int(value->int_val);
-  case VALUE_FLOAT:
-    return value_create_float(value->float_val);
+Value value_copy(Value value) {
+  switch (value.type) {
   case VALUE_STRING:
-    return value_create_string(value->string_val);
-  case VALUE_BOOL:
-    return value_create_bool(value->bool_val);
+    string_retain(value.string_val);
+    return value;
   case VALUE_FUNCTION:
-    return value_create_function(value->function_val);
-  case VALUE_NULL:
-    return value_create_null();
+    function_retain(value.function_val);
+    return value;
   default:
-    return NULL;
+    return value;
   }
 }
 
-void value_print(Value *value) {
-  if (!value) {
-    printf("null");
-    return;
-  }
-
-  switch (value->type) {
+void value_print(Value value) {
+  switch (value.type) {
   case VALUE_INT:
-    printf("%d", value->int_val);
+    printf("%d", value.int_val);
     break;   
   case VALUE_FLOAT:
     // Lizard won't care if the result is too big
-    printf("%.17g", value->float_val);
+    printf("%.17g", value.float_val);
     break;
   case VALUE_STRING:
-    printf("%s", value->string_val);
+    fwrite(value.string_val->chars, 1, value.string_val->length, stdout);
     break;
   case VALUE_BOOL:
-    printf("%s", value->bool_val ? "true" : "false");
+    printf("%s", value.bool_val ? "true" : "false");
     break;
   case VALUE_FUNCTION:
-    printf("<function %s>", value->function_val->name);
+    printf("<function %s>", value.function_val->name);
     break;
   case VALUE_NULL:
+  case VALUE_NONE:
     printf("null");
     break;
   }
 }
 
-char *value_to_string(Value *value) {
-  if (!value)
-    return strdup("null");
-
-  char *result = malloc(256);
-  switch (value->type) {
+const char *value_text(Value value, char buffer[VALUE_TEXT_SIZE], size_t *length) {
+  int written;
+  switch (value.type) {
+  case VALUE_STRING:
+    *length = value.string_val->length;
+    return value.string_val->chars;
   case VALUE_INT:
-    snprintf(result, 256, "%d", value->int_val);
+    written = snprintf(buffer, VALUE_TEXT_SIZE, "%d", value.int_val);
     break;
   case VALUE_FLOAT:
-    snprintf(result, 256, "%.17g", value->float_val);
+    written = snprintf(buffer, VALUE_TEXT_SIZE, "%.17g", value.float_val);
     break;
-  case VALUE_STRING:
-    return strdup(value->string_val);
   case VALUE_BOOL:
-    snprintf(result, 256, "%s", value->bool_val ? "true" : "false");
+    written = snprintf(buffer, VALUE_TEXT_SIZE, "%s", value.bool_val ? "true" : "false");
     break;
   case VALUE_FUNCTION:
-    snprintf(result, 256, "<function %s>", value->function_val->name);
+    written = snprintf(buffer, VALUE_TEXT_SIZE, "<function %s>", value.function_val->name);
     break;
-  case VALUE_NULL:
-    snprintf(result, 256, "null");
+  default:
+    written = snprintf(buffer, VALUE_TEXT_SIZE, "null");
     break;
   }
+  *length = written < VALUE_TEXT_SIZE ? (size_t)written : VALUE_TEXT_SIZE - 1;
+  return buffer;
+}
+
+char *value_to_string(Value value) {
+  char buffer[VALUE_TEXT_SIZE];
+  size_t length;
+  const char *text = value_text(value, buffer, &length);
+
+  char *result = malloc(length + 1);
+  memcpy(result, text, length);
+  result[length] = '\0';
   return result;
 }
 
@@ -155,28 +126,36 @@ const char *value_type_to_string(ValueType type) {
   }
 }
 
-Function *function_create(const char *name, char **param_names, char **param_types, 
-                         struct ASTNode **param_defaults, bool *param_has_default,
-                         int param_count, const char *return_type, struct ASTNode *body,
-                         bool is_public, Position declaration_pos) {
-  Function *func = malloc(sizeof(Function));
+Function *function_create(const char *name, char **param_names,
+                          const Type **param_types,
+                          struct ASTNode **param_defaults, bool *param_has_default,
+                          int param_count, const Type *return_type,
+                          struct ASTNode *body, bool is_public,
+                          Position declaration_pos) {
+  Function *func = pool_alloc(sizeof(Function));
   func->name = strdup(name);
   func->param_count = param_count;
   func->body = body;
   func->is_public = is_public;
   func->declaration_pos = declaration_pos;
+  func->chunk = NULL;
+  func->ref_count = 1;
+  func->required_param_count = 0;
 
   if (param_count > 0) {
-    func->param_names = malloc(sizeof(char *) * param_count);
-    func->param_types = malloc(sizeof(char *) * param_count);
+    func->param_names = malloc(sizeof(Symbol *) * param_count);
+    func->param_types = malloc(sizeof(Type *) * param_count);
     func->param_defaults = malloc(sizeof(struct ASTNode *) * param_count);
     func->param_has_default = malloc(sizeof(bool) * param_count);
     
     for (int i = 0; i < param_count; i++) {
-      func->param_names[i] = strdup(param_names[i]);
-      func->param_types[i] = param_types[i] ? strdup(param_types[i]) : NULL;
+      func->param_names[i] = symbol_intern(param_names[i]);
+      func->param_types[i] = param_types[i];
       func->param_defaults[i] = param_defaults[i];
       func->param_has_default[i] = param_has_default[i];
+      if (!param_has_default[i]) {
+        func->required_param_count++;
+      }
     }
   } else {
     func->param_names = NULL;
@@ -185,46 +164,129 @@ Function *function_create(const char *name, char **param_names, char **param_typ
     func->param_has_default = NULL;
   }
 
-  func->return_type = return_type ? strdup(return_type) : NULL;
+  func->return_type = return_type;
   return func;
 }
 
-void function_destroy(Function *func) {
-  if (!func)
+void function_retain(Function *func) {
+  func->ref_count++;
+}
+
+void function_release(Function *func) {
+  if (!func || --func->ref_count > 0)
     return;
 
   free(func->name);
   if (func->param_names) {
-    for (int i = 0; i < func->param_count; i++) {
-      free(func->param_names[i]);
-      free(func->param_types[i]);
-    }
     free(func->param_names);
     free(func->param_types);
     free(func->param_defaults);
     free(func->param_has_default);
   }
-  free(func->return_type);
-  free(func);
-}
-
-char *infer_type_from_value(Value *value) {
-  if (!value) return strdup("null");
-  
-  switch (value->type) {
-    case VALUE_INT:
-      return strdup("int");
-    case VALUE_FLOAT:
-      return strdup("float");
-    case VALUE_STRING:
-      return strdup("string");
-    case VALUE_BOOL:
-      return strdup("bool");
-    case VALUE_FUNCTION:
-      return strdup("function");
-    case VALUE_NULL:
-      return strdup("null");
-    default:
-      return strdup("unknown");
+  pool_free(func, sizeof(Function));
+}
+
+// Annotations the language gives a meaning to. Any other spelling still
+// gets a descriptor, but no value satisfies it.
+static const struct {
+  const char *name;
+  ValueType accepts;
+} builtin_types[] = {
+  {"int", VALUE_INT},
+  {"float", VALUE_FLOAT},
+  {"string", VALUE_STRING},
+  {"bool", VALUE_BOOL},
+  {"void", VALUE_NULL},
+};
+
+static Type **types;
+static int type_count;
+static int type_capacity;
+
+const Type *type_intern(Symbol *symbol) {
+  for (int i = 0; i < type_count; i++) {
+    if (types[i]->name == symbol)
+      return types[i];
+  }
+
+  if (type_count >= type_capacity) {
+    type_capacity = type_capacity ? type_capacity * 2 : 16;
+    types = realloc(types, sizeof(Type *) * type_capacity);
   }
-}
\ No newline at end of file
+
+  Type *type = malloc(sizeof(Type));
+  type->name = symbol;
+  type->accepts = VALUE_NONE;
+  for (size_t i = 0; i < sizeof(builtin_types) / sizeof(builtin_types[0]); i++) {
+    if (strcmp(builtin_types[i].name, symbol->name) == 0) {
+      type->accepts = builtin_types[i].accepts;
+      break;
+    }
+  }
+
+  types[type_count++] = type;
+  return type;
+}
+
+const Type *type_of_value(Value value) {
+  static const Type *inferred[VALUE_FUNCTION + 1];
+  if (!inferred[value.type]) {
+    inferred[value.type] = type_intern(symbol_intern(
+        value.type == VALUE_NONE ? "null" : value_type_to_string(value.type)));
+  }
+  return inferred[value.type];
+}
+
+String *string_alloc(size_t length) {
+  String *string = pool_alloc(sizeof(String) + length + 1);
+  if (!string)
+    return NULL;
+
+  string->ref_count = 1;
+  string->hash = 0;
+  string->length = length;
+  string->chars[length] = '\0';
+  return string;
+}
+
+String *string_create(const char *chars, size_t length) {
+  String *string = string_alloc(length);
+  if (!string)
+    return NULL;
+
+  memcpy(string->chars, chars, length);
+  return string;
+}
+
+static void string_release_cleanup(void *string) {
+  string_release(string);
+}
+
+bool string_attach(Arena *arena, String *string) {
+  if (arena_add_cleanup(arena, string_release_cleanup, string))
+    return true;
+  string_release(string);
+  return false;
+}
+
+String *string_create_literal(Arena *arena, const char *chars, size_t length) {
+  String *string = string_create(chars, length);
+  if (!string || !string_attach(arena, string))
+    return NULL;
+  return string;
+}
+
+void string_retain(String *string) {
+  string->ref_count++;
+}
+
+void string_release(String *string) {
+  if (--string->ref_count == 0)
+    pool_free(string, sizeof(String) + string->length + 1);
+}
+
+uint32_t string_hash(String *string) {
+  if (string->hash == 0)
+    string->hash = symbol_hash(string->chars, string->length);
+  return string->hash;
+}
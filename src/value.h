@@ -6,8 +6,11 @@
 #include <string.h>
 #include <stdbool.h>
 #include "lexer.h"
+#include "symbol.h"
+#include "arena.h"
 
 typedef enum {
+    VALUE_NONE,     // No value at all: a statement, or an evaluation that failed
     VALUE_NULL,
     VALUE_INT,
     VALUE_FLOAT,
@@ -16,51 +19,144 @@ typedef enum {
     VALUE_FUNCTION
 } ValueType;
 
+// Interned descriptor for a type annotation. Each spelling maps to exactly
+// one descriptor, so checking a value against a declared type compares its
+// tag with `accepts` and needs no string work.
+typedef struct Type {
+    Symbol *name;
+    ValueType accepts;  // VALUE_NONE if no value satisfies the annotation
+} Type;
+
 typedef struct Value Value;
 typedef struct Function Function;
+typedef struct String String;
+
+// Immutable text shared between Values by reference count, so copying a
+// string Value is O(1) however long the string is. Literal strings in the
+// tree are counted too: the tree's arena holds one reference and drops it
+// when destroyed, so evaluating a literal only retains it and a Value made
+// from one may outlive the tree.
+struct String {
+    int ref_count;
+    uint32_t hash;                   // 0 until string_hash first needs it
+    size_t length;
+    char chars[];                    // NUL-terminated
+};
 
 struct Function {
     char *name;
-    char **param_names;
-    char **param_types;
+    Symbol **param_names;
+    const Type **param_types;        // NULL entries until inferred from the first call
     struct ASTNode **param_defaults; // New: default values
     bool *param_has_default;         // New: track which params have defaults
     int param_count;
-    char *return_type;
+    int required_param_count;        // Parameters without a default
+    const Type *return_type;
     struct ASTNode *body;
     bool is_public;
     Position declaration_pos;
+    struct Chunk *chunk;             // Compiled body when run by the VM
+    int ref_count;                   // One per Value holding the function
 };
 
+// Values are passed and stored by value (16 bytes). Scalars live inline;
+// only strings and functions point to heap objects. Each string or function
+// Value holds one reference to its String or Function, so
+// value_copy/value_destroy must be paired like any owned resource.
 struct Value {
     ValueType type;
     union {
         int int_val;
         double float_val;
-        char *string_val;
+        String *string_val;
         bool bool_val;
         Function *function_val;
     };
 };
 
-Value *value_create_int(int val);
-Value *value_create_float(double val);
-Value *value_create_string(const char *val);
-Value *value_create_bool(bool val);
-Value *value_create_function(Function *func);
-Value *value_create_null(void);
-void value_destroy(Value *value);
-Value *value_copy(Value *value);
-void value_print(Value *value);
-char *value_to_string(Value *value);
+static inline Value value_create_int(int val) {
+    Value value;
+    value.type = VALUE_INT;
+    value.int_val = val;
+    return value;
+}
+
+static inline Value value_create_float(double val) {
+    Value value;
+    value.type = VALUE_FLOAT;
+    value.float_val = val;
+    return value;
+}
+
+static inline Value value_create_bool(bool val) {
+    Value value;
+    value.type = VALUE_BOOL;
+    value.bool_val = val;
+    return value;
+}
+
+static inline Value value_create_null(void) {
+    Value value;
+    value.type = VALUE_NULL;
+    value.int_val = 0;
+    return value;
+}
+
+static inline Value value_none(void) {
+    Value value;
+    value.type = VALUE_NONE;
+    value.int_val = 0;
+    return value;
+}
+
+static inline bool value_is_none(Value value) {
+    return value.type == VALUE_NONE;
+}
+
+Value value_create_string(const char *val);
+Value value_from_string(String *string); // Takes over the caller's reference
+Value value_create_function(Function *func); // Takes over the caller's reference
+void value_destroy(Value value);
+Value value_copy(Value value);
+void value_print(Value value);
+char *value_to_string(Value value);
+// The text value_to_string would return, without the copy: strings come back
+// as they are and anything else is formatted into `buffer`.
+#define VALUE_TEXT_SIZE 256
+const char *value_text(Value value, char buffer[VALUE_TEXT_SIZE], size_t *length);
 const char *value_type_to_string(ValueType type);
 
-Function *function_create(const char *name, char **param_names, char **param_types, 
-                         struct ASTNode **param_defaults, bool *param_has_default,
-                         int param_count, const char *return_type, struct ASTNode *body, 
-                         bool is_public, Position declaration_pos);
-void function_destroy(Function *func);
+// Returns a function holding one reference, owned by the caller.
+Function *function_create(const char *name, char **param_names,
+                          const Type **param_types,
+                          struct ASTNode **param_defaults, bool *param_has_default,
+                          int param_count, const Type *return_type,
+                          struct ASTNode *body, bool is_public,
+                          Position declaration_pos);
+void function_retain(Function *func);
+void function_release(Function *func);
+
+// Returns a string holding one reference, owned by the caller.
+String *string_create(const char *chars, size_t length);
+// Like string_create, but the text is left for the caller to fill in before
+// the string is shared.
+String *string_alloc(size_t length);
+// A string for a literal in the tree, whose reference `arena` holds and
+// releases when destroyed.
+String *string_create_literal(Arena *arena, const char *chars, size_t length);
+// Hands the caller's reference to `string` over to `arena`. On failure the
+// reference is released and false is returned.
+bool string_attach(Arena *arena, String *string);
+void string_retain(String *string);
+void string_release(String *string);
+uint32_t string_hash(String *string);
+
+const Type *type_intern(Symbol *name);
+const Type *type_of_value(Value value);  // What an untyped parameter infers
 
-char *infer_type_from_value(Value *value);
+// A missing annotation accepts any value.
+static inline bool type_accepts(const Type *type, Value value) {
+    return !type || value.type == type->accepts;
+}
 
 #endif
\ No newline at end of file
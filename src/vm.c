@@ -0,0 +1,809 @@
+#include "vm.h"
+#include "compiler.h"
+#include "error.h"
+
+VM *vm_create(Interpreter *interpreter) {
+  VM *vm = malloc(sizeof(VM));
+  if (!vm)
+    return NULL;
+
+  vm->interpreter = interpreter;
+  vm->stack_capacity = VM_STACK_INITIAL;
+  vm->stack = malloc(sizeof(Value) * vm->stack_capacity);
+  vm->stack_top = vm->stack;
+  vm->callee_capacity = 64;
+  vm->callees = malloc(sizeof(Function *) * vm->callee_capacity);
+  vm->callee_top = 0;
+  vm->frame_capacity = VM_FRAMES_INITIAL;
+  vm->frames = malloc(sizeof(CallFrame) * vm->frame_capacity);
+  vm->frame_count = 0;
+  vm->programs = NULL;
+  vm->program_count = 0;
+  vm->program_capacity = 0;
+  return vm;
+}
+
+void vm_destroy(VM *vm) {
+  if (!vm)
+    return;
+
+  while (vm->stack_top > vm->stack) {
+    value_destroy(*--vm->stack_top);
+  }
+  for (int i = 0; i < vm->program_count; i++) {
+    chunk_destroy(vm->programs[i]);
+  }
+  free(vm->programs);
+  free(vm->stack);
+  free(vm->callees);
+  free(vm->frames);
+  free(vm);
+}
+
+// False, leaving the stacks as they were, if they cannot grow.
+static bool vm_reserve(VM *vm, int stack_slots, int callee_slots) {
+  int used = (int)(vm->stack_top - vm->stack);
+  if (used + stack_slots > vm->stack_capacity) {
+    int capacity = vm->stack_capacity;
+    while (used + stack_slots > capacity) {
+      capacity *= 2;
+    }
+    Value *stack = realloc(vm->stack, sizeof(Value) * capacity);
+    if (!stack)
+      return false;
+    vm->stack = stack;
+    vm->stack_top = stack + used;
+    vm->stack_capacity = capacity;
+  }
+
+  if (vm->callee_top + callee_slots > vm->callee_capacity) {
+    int capacity = vm->callee_capacity;
+    while (vm->callee_top + callee_slots > capacity) {
+      capacity *= 2;
+    }
+    Function **callees = realloc(vm->callees, sizeof(Function *) * capacity);
+    if (!callees)
+      return false;
+    vm->callees = callees;
+    vm->callee_capacity = capacity;
+  }
+  return true;
+}
+
+// Returns the new top frame, or NULL if there is no memory for it.
+static CallFrame *vm_push_frame(VM *vm) {
+  if (vm->frame_count == vm->frame_capacity) {
+    CallFrame *frames =
+        realloc(vm->frames, sizeof(CallFrame) * vm->frame_capacity * 2);
+    if (!frames)
+      return NULL;
+    vm->frames = frames;
+    vm->frame_capacity *= 2;
+  }
+  return &vm->frames[vm->frame_count++];
+}
+
+static void vm_report_out_of_memory(VM *vm, Position pos) {
+  error_report(ERROR_RUNTIME, pos, "Out of memory for the call stack",
+               "Check for recursion that never returns, or lower --max-depth");
+  vm->interpreter->halted = true;
+}
+
+static void vm_truncate_stack(VM *vm, int depth) {
+  Value *target = vm->stack + depth;
+  while (vm->stack_top > target) {
+    value_destroy(*--vm->stack_top);
+  }
+}
+
+static void vm_unwind_scopes(VM *vm, Environment *target) {
+  Interpreter *interpreter = vm->interpreter;
+  while (interpreter->current_env && interpreter->current_env != target) {
+    Environment *scope = interpreter->current_env;
+    interpreter->current_env = scope->parent;
+    environment_pop(interpreter->scopes, scope);
+  }
+}
+
+static void vm_pop_frame(VM *vm) {
+  CallFrame *frame = &vm->frames[vm->frame_count - 1];
+  vm_unwind_scopes(vm, frame->saved_env);
+  vm_truncate_stack(vm, frame->base);
+  vm->callee_top = frame->callee_base;
+  vm->frame_count--;
+}
+
+// Mirrors the tree walker: a runtime error abandons the innermost statement
+// (or format placeholder) and execution carries on after it. Errors outside
+// any region, such as a failing default argument, escape to the caller.
+static bool vm_recover(VM *vm) {
+  while (vm->frame_count > 0) {
+    CallFrame *frame = &vm->frames[vm->frame_count - 1];
+    int offset = (int)(frame->ip - frame->chunk->code);
+    RecoveryRegion *region = chunk_find_region(frame->chunk, offset);
+
+    if (region) {
+      vm_truncate_stack(vm, frame->base + region->stack_depth);
+      vm->callee_top = frame->callee_base + region->callee_depth;
+      if (region->kind == RECOVER_FORMAT) {
+        printf("LIZARD-INTERPRET-DEBUG: Failed to evaluate expression at index %d\n",
+               region->index);
+        *vm->stack_top++ = value_none();
+      }
+      frame->ip = frame->chunk->code + region->end;
+      return true;
+    }
+
+    vm_pop_frame(vm);
+  }
+
+  return false;
+}
+
+static void vm_abort(VM *vm) {
+  while (vm->frame_count > 0) {
+    vm_pop_frame(vm);
+  }
+}
+
+#define LOCAL_LOAD_WIDTH 6  // OP_GET_LOCAL and its quickened forms
+#define CONSTANT_WIDTH 3
+
+// The entry a local load at `instruction` reads, if its resolved slot holds
+// the name; otherwise NULL, and only the full lookup will do.
+static inline EnvEntry *vm_local_entry(Chunk *chunk, Environment *env,
+                                       const uint8_t *instruction) {
+  Symbol *name = chunk->names[instruction[1] | (instruction[2] << 8)];
+  int depth = instruction[3];
+  int slot = instruction[4] | (instruction[5] << 8);
+
+  for (int i = 0; i < depth; i++) {
+    env = env->parent;
+  }
+  if (slot >= env->count)
+    return NULL;
+  EnvEntry *entry = &env->entries[slot];
+  return entry->symbol == name && entry->is_initialized ? entry : NULL;
+}
+
+static bool vm_is_local_load(uint8_t op) {
+  return op == OP_GET_LOCAL || op == OP_GET_LOCAL_FAST ||
+         op == OP_GET_LOCAL_PAIR || op == OP_GET_LOCAL_CONSTANT;
+}
+
+// Called after a generic local load at `instruction` found its slot bound.
+// The load is fused with a local or constant load right after it, which is
+// then run as part of it; the instruction after is left as it was.
+static void vm_quicken_local(Interpreter *interpreter, Chunk *chunk,
+                             uint8_t *instruction) {
+  uint8_t *next = instruction + LOCAL_LOAD_WIDTH;
+  OpCode quick = OP_GET_LOCAL_FAST;
+
+  if (vm_is_local_load(*next) &&
+      vm_local_entry(chunk, interpreter->current_env, next)) {
+    quick = OP_GET_LOCAL_PAIR;
+  } else if (*next == OP_CONSTANT) {
+    quick = OP_GET_LOCAL_CONSTANT;
+  }
+  *instruction = (uint8_t)quick;
+  INTERPRETER_COUNT(interpreter, quickened);
+}
+
+// Called before a generic arithmetic instruction runs on its operands.
+static void vm_quicken_binary(Interpreter *interpreter, uint8_t *instruction,
+                              Value left, Value right) {
+  OpCode quick = OP_COUNT;
+
+  if (left.type == VALUE_INT && right.type == VALUE_INT) {
+    switch (*instruction) {
+    case OP_ADD: quick = OP_ADD_INT; break;
+    case OP_SUBTRACT: quick = OP_SUBTRACT_INT; break;
+    case OP_MULTIPLY: quick = OP_MULTIPLY_INT; break;
+    case OP_MODULO: quick = OP_MODULO_INT; break;
+    case OP_INT_DIVIDE: quick = OP_INT_DIVIDE_INT; break;
+    default: break;
+    }
+  } else if (left.type == VALUE_FLOAT && right.type == VALUE_FLOAT) {
+    switch (*instruction) {
+    case OP_ADD: quick = OP_ADD_FLOAT; break;
+    case OP_SUBTRACT: quick = OP_SUBTRACT_FLOAT; break;
+    case OP_MULTIPLY: quick = OP_MULTIPLY_FLOAT; break;
+    case OP_DIVIDE: quick = OP_DIVIDE_FLOAT; break;
+    default: break;
+    }
+  }
+
+  if (quick == OP_COUNT)
+    return;
+  *instruction = (uint8_t)quick;
+  INTERPRETER_COUNT(interpreter, quickened);
+}
+
+static void vm_execute(VM *vm, Chunk *program) {
+  Interpreter *interpreter = vm->interpreter;
+
+  CallFrame *frame = NULL;
+  if (vm_reserve(vm, program->max_stack, program->max_callees))
+    frame = vm_push_frame(vm);
+  if (!frame) {
+    vm_report_out_of_memory(vm, chunk_position_at(program, 0));
+    return;
+  }
+  frame->func = NULL;
+  frame->chunk = program;
+  frame->ip = program->code;
+  frame->base = (int)(vm->stack_top - vm->stack);
+  frame->callee_base = vm->callee_top;
+  frame->argc = 0;
+  frame->saved_env = interpreter->current_env;
+  frame->call_pos = chunk_position_at(program, 0);
+
+  uint8_t *ip = frame->ip;
+  Value *sp = vm->stack_top;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)(ip[-2] | (ip[-1] << 8)))
+#define CURRENT_POS() \
+  chunk_position_at(frame->chunk, (int)(ip - frame->chunk->code) - 1)
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define SAVE_STATE() (frame->ip = ip, vm->stack_top = sp)
+#define LOAD_STATE()                              \
+  do {                                            \
+    frame = &vm->frames[vm->frame_count - 1];     \
+    ip = frame->ip;                               \
+    sp = vm->stack_top;                           \
+  } while (0)
+
+#define BINARY_OP(token)                                                  \
+  do {                                                                    \
+    uint8_t *instruction = ip - 1;                                        \
+    bool deoptimized = READ_BYTE();                                       \
+    Value right = POP();                                                  \
+    Value left = POP();                                                   \
+    if (!deoptimized)                                                     \
+      vm_quicken_binary(interpreter, instruction, left, right);           \
+    Value result =                                                        \
+        interpreter_binary_operation(token, left, right, CURRENT_POS());  \
+    value_destroy(left);                                                  \
+    value_destroy(right);                                                 \
+    if (value_is_none(result))                                            \
+      goto runtime_error;                                                 \
+    PUSH(result);                                                         \
+  } while (0)
+
+// Every handler ends in NEXT(). With computed goto that is an indirect jump
+// straight to the next handler, one per handler, so the branch predictor
+// learns which opcode tends to follow which; the switch form sends every
+// instruction through the single shared branch at the top of the loop.
+#ifdef VM_COMPUTED_GOTO
+#define CASE(op) label_##op
+#define DISPATCH() goto *dispatch_table[READ_BYTE()];
+#define NEXT() goto *dispatch_table[READ_BYTE()]
+  static void *const dispatch_table[OP_COUNT + 1] = {
+    [OP_CONSTANT] = &&CASE(OP_CONSTANT),
+    [OP_CONSTANT_LONG] = &&CASE(OP_CONSTANT_LONG),
+    [OP_NULL] = &&CASE(OP_NULL),
+    [OP_POP] = &&CASE(OP_POP),
+    [OP_GET_NAME] = &&CASE(OP_GET_NAME),
+    [OP_GET_LOCAL] = &&CASE(OP_GET_LOCAL),
+    [OP_GET_LOCAL_FAST] = &&CASE(OP_GET_LOCAL_FAST),
+    [OP_GET_LOCAL_PAIR] = &&CASE(OP_GET_LOCAL_PAIR),
+    [OP_GET_LOCAL_CONSTANT] = &&CASE(OP_GET_LOCAL_CONSTANT),
+    [OP_SET_NAME] = &&CASE(OP_SET_NAME),
+    [OP_SET_LOCAL] = &&CASE(OP_SET_LOCAL),
+    [OP_DEFINE_NAME] = &&CASE(OP_DEFINE_NAME),
+    [OP_ADD] = &&CASE(OP_ADD),
+    [OP_SUBTRACT] = &&CASE(OP_SUBTRACT),
+    [OP_MULTIPLY] = &&CASE(OP_MULTIPLY),
+    [OP_DIVIDE] = &&CASE(OP_DIVIDE),
+    [OP_MODULO] = &&CASE(OP_MODULO),
+    [OP_INT_DIVIDE] = &&CASE(OP_INT_DIVIDE),
+    [OP_ADD_INT] = &&CASE(OP_ADD_INT),
+    [OP_SUBTRACT_INT] = &&CASE(OP_SUBTRACT_INT),
+    [OP_MULTIPLY_INT] = &&CASE(OP_MULTIPLY_INT),
+    [OP_MODULO_INT] = &&CASE(OP_MODULO_INT),
+    [OP_INT_DIVIDE_INT] = &&CASE(OP_INT_DIVIDE_INT),
+    [OP_ADD_FLOAT] = &&CASE(OP_ADD_FLOAT),
+    [OP_SUBTRACT_FLOAT] = &&CASE(OP_SUBTRACT_FLOAT),
+    [OP_MULTIPLY_FLOAT] = &&CASE(OP_MULTIPLY_FLOAT),
+    [OP_DIVIDE_FLOAT] = &&CASE(OP_DIVIDE_FLOAT),
+    [OP_NEGATE] = &&CASE(OP_NEGATE),
+    [OP_UNARY] = &&CASE(OP_UNARY),
+    [OP_FORMAT] = &&CASE(OP_FORMAT),
+    [OP_PRINT] = &&CASE(OP_PRINT),
+    [OP_PRINTLN] = &&CASE(OP_PRINTLN),
+    [OP_LOOKUP_CALLEE] = &&CASE(OP_LOOKUP_CALLEE),
+    [OP_LOOKUP_LOCAL_CALLEE] = &&CASE(OP_LOOKUP_LOCAL_CALLEE),
+    [OP_CHECK_ARG] = &&CASE(OP_CHECK_ARG),
+    [OP_CALL] = &&CASE(OP_CALL),
+    [OP_DEFAULT_ARG] = &&CASE(OP_DEFAULT_ARG),
+    [OP_CHECK_PARAM] = &&CASE(OP_CHECK_PARAM),
+    [OP_ENTER] = &&CASE(OP_ENTER),
+    [OP_PUSH_SCOPE] = &&CASE(OP_PUSH_SCOPE),
+    [OP_POP_SCOPE] = &&CASE(OP_POP_SCOPE),
+    [OP_SCOPE_ELIDED] = &&CASE(OP_SCOPE_ELIDED),
+    [OP_DEFINE_FUNCTION] = &&CASE(OP_DEFINE_FUNCTION),
+    [OP_RETURN] = &&CASE(OP_RETURN),
+    [OP_RETURN_NOTHING] = &&CASE(OP_RETURN_NOTHING),
+    [OP_HALT] = &&CASE(OP_HALT),
+    [OP_COUNT] = &&CASE(OP_COUNT),
+  };
+#else
+#define CASE(op) case op
+#define DISPATCH() switch ((OpCode)READ_BYTE())
+#define NEXT() break
+#endif
+
+// Puts a quickened instruction whose guard failed back in its generic form
+// and runs it again from the start. Not wrapped in do/while: it continues
+// the dispatch loop.
+#define DEOPTIMIZE(instruction, generic)                                  \
+  {                                                                       \
+    *(instruction) = (generic);                                           \
+    INTERPRETER_COUNT(interpreter, deopts);                               \
+    ip = (instruction);                                                   \
+    continue;                                                             \
+  }
+
+// Quickened arithmetic on two scalars of `kind`; nothing needs destroying.
+// A zero divisor passes the guard and is reported by the generic helper.
+#define QUICK_BINARY(quick, generic, token, kind, field, create, operator,  \
+                     checks_zero)                                         \
+  {                                                                       \
+    uint8_t *instruction = ip - 1;                                        \
+    Value right = sp[-1];                                                 \
+    Value left = sp[-2];                                                  \
+    if (left.type != (kind) || right.type != (kind)) {                    \
+      instruction[1] = 1;                                                 \
+      DEOPTIMIZE(instruction, generic);                                   \
+    }                                                                     \
+    ip++;                                                                 \
+    if ((checks_zero) && right.field == 0) {                              \
+      sp -= 2;                                                            \
+      interpreter_binary_operation(token, left, right, CURRENT_POS());    \
+      goto runtime_error;                                                 \
+    }                                                                     \
+    sp[-2] = create(left.field operator right.field);                     \
+    sp--;                                                                 \
+    INTERPRETER_COUNT(interpreter, quick_runs[quick]);                    \
+  }
+
+  for (;;) {
+    DISPATCH() {
+    CASE(OP_CONSTANT):
+      PUSH(value_copy(frame->chunk->constants[READ_SHORT()]));
+      NEXT();
+
+    CASE(OP_CONSTANT_LONG): {
+      uint32_t low = READ_SHORT();
+      uint32_t high = READ_SHORT();
+      PUSH(value_copy(frame->chunk->constants[low | (high << 16)]));
+      NEXT();
+    }
+
+    CASE(OP_NULL):
+      PUSH(value_create_null());
+      NEXT();
+
+    CASE(OP_POP):
+      value_destroy(POP());
+      NEXT();
+
+    CASE(OP_GET_NAME):
+    CASE(OP_GET_LOCAL): {
+      uint8_t *instruction = ip - 1;
+      bool local = *instruction == OP_GET_LOCAL;
+      Symbol *name = frame->chunk->names[READ_SHORT()];
+      EnvSlot where = ENV_SLOT_DYNAMIC;
+      if (local) {
+        where.depth = READ_BYTE();
+        where.slot = READ_SHORT();
+      }
+      Value value =
+          interpreter_lookup_variable(interpreter, name, where, CURRENT_POS());
+      if (value_is_none(value))
+        goto runtime_error;
+      PUSH(value);
+      if (local && vm_local_entry(frame->chunk, interpreter->current_env,
+                                  instruction)) {
+        vm_quicken_local(interpreter, frame->chunk, instruction);
+      }
+      NEXT();
+    }
+
+    CASE(OP_GET_LOCAL_FAST): {
+      uint8_t *instruction = ip - 1;
+      EnvEntry *entry =
+          vm_local_entry(frame->chunk, interpreter->current_env, instruction);
+      if (!entry)
+        DEOPTIMIZE(instruction, OP_GET_LOCAL);
+      PUSH(value_copy(entry->value));
+      ip = instruction + LOCAL_LOAD_WIDTH;
+      INTERPRETER_COUNT(interpreter, quick_runs[OP_GET_LOCAL_FAST]);
+      NEXT();
+    }
+
+    CASE(OP_GET_LOCAL_PAIR): {
+      uint8_t *instruction = ip - 1;
+      EnvEntry *first =
+          vm_local_entry(frame->chunk, interpreter->current_env, instruction);
+      EnvEntry *second =
+          vm_local_entry(frame->chunk, interpreter->current_env,
+                         instruction + LOCAL_LOAD_WIDTH);
+      if (!first || !second)
+        DEOPTIMIZE(instruction, OP_GET_LOCAL);
+      PUSH(value_copy(first->value));
+      PUSH(value_copy(second->value));
+      ip = instruction + 2 * LOCAL_LOAD_WIDTH;
+      INTERPRETER_COUNT(interpreter, quick_runs[OP_GET_LOCAL_PAIR]);
+      NEXT();
+    }
+
+    CASE(OP_GET_LOCAL_CONSTANT): {
+      uint8_t *instruction = ip - 1;
+      EnvEntry *entry =
+          vm_local_entry(frame->chunk, interpreter->current_env, instruction);
+      if (!entry)
+        DEOPTIMIZE(instruction, OP_GET_LOCAL);
+      const uint8_t *constant = instruction + LOCAL_LOAD_WIDTH;
+      PUSH(value_copy(entry->value));
+      PUSH(value_copy(frame->chunk->constants[constant[1] | (constant[2] << 8)]));
+      ip = instruction + LOCAL_LOAD_WIDTH + CONSTANT_WIDTH;
+      INTERPRETER_COUNT(interpreter, quick_runs[OP_GET_LOCAL_CONSTANT]);
+      NEXT();
+    }
+
+    CASE(OP_SET_NAME):
+    CASE(OP_SET_LOCAL): {
+      bool local = ip[-1] == OP_SET_LOCAL;
+      Symbol *name = frame->chunk->names[READ_SHORT()];
+      EnvSlot where = ENV_SLOT_DYNAMIC;
+      if (local) {
+        where.depth = READ_BYTE();
+        where.slot = READ_SHORT();
+      }
+      Value value = POP();
+      bool ok = interpreter_assign_variable(interpreter, name, where, &value,
+                                            CURRENT_POS());
+      value_destroy(value);
+      if (!ok)
+        goto runtime_error;
+      NEXT();
+    }
+
+    CASE(OP_DEFINE_NAME): {
+      Symbol *name = frame->chunk->names[READ_SHORT()];
+      uint16_t slot = READ_SHORT();
+      uint16_t type_index = READ_SHORT();
+      uint8_t flags = READ_BYTE();
+      const Type *var_type =
+          type_index == NO_OPERAND ? NULL : frame->chunk->types[type_index];
+      Value value = (flags & DEFINE_HAS_VALUE) ? POP() : value_none();
+      bool ok = interpreter_define_variable(interpreter, name,
+                                            slot == NO_OPERAND ? -1 : slot,
+                                            var_type,
+                                            (flags & DEFINE_FIXED) != 0,
+                                            (flags & DEFINE_HAS_VALUE) ? &value : NULL,
+                                            CURRENT_POS());
+      value_destroy(value);
+      if (!ok)
+        goto runtime_error;
+      NEXT();
+    }
+
+    CASE(OP_ADD):
+      BINARY_OP(TOKEN_PLUS);
+      NEXT();
+    CASE(OP_SUBTRACT):
+      BINARY_OP(TOKEN_MINUS);
+      NEXT();
+    CASE(OP_MULTIPLY):
+      BINARY_OP(TOKEN_MULTIPLY);
+      NEXT();
+    CASE(OP_DIVIDE):
+      BINARY_OP(TOKEN_DIVIDE);
+      NEXT();
+    CASE(OP_MODULO):
+      BINARY_OP(TOKEN_MODULO);
+      NEXT();
+    CASE(OP_INT_DIVIDE):
+      BINARY_OP(TOKEN_INT_DIVIDE);
+      NEXT();
+
+    CASE(OP_ADD_INT):
+      QUICK_BINARY(OP_ADD_INT, OP_ADD, TOKEN_PLUS, VALUE_INT, int_val,
+                   value_create_int, +, false);
+      NEXT();
+    CASE(OP_SUBTRACT_INT):
+      QUICK_BINARY(OP_SUBTRACT_INT, OP_SUBTRACT, TOKEN_MINUS, VALUE_INT,
+                   int_val, value_create_int, -, false);
+      NEXT();
+    CASE(OP_MULTIPLY_INT):
+      QUICK_BINARY(OP_MULTIPLY_INT, OP_MULTIPLY, TOKEN_MULTIPLY, VALUE_INT,
+                   int_val, value_create_int, *, false);
+      NEXT();
+    CASE(OP_MODULO_INT):
+      QUICK_BINARY(OP_MODULO_INT, OP_MODULO, TOKEN_MODULO, VALUE_INT, int_val,
+                   value_create_int, %, true);
+      NEXT();
+    CASE(OP_INT_DIVIDE_INT):
+      QUICK_BINARY(OP_INT_DIVIDE_INT, OP_INT_DIVIDE, TOKEN_INT_DIVIDE,
+                   VALUE_INT, int_val, value_create_int, /, true);
+      NEXT();
+    CASE(OP_ADD_FLOAT):
+      QUICK_BINARY(OP_ADD_FLOAT, OP_ADD, TOKEN_PLUS, VALUE_FLOAT, float_val,
+                   value_create_float, +, false);
+      NEXT();
+    CASE(OP_SUBTRACT_FLOAT):
+      QUICK_BINARY(OP_SUBTRACT_FLOAT, OP_SUBTRACT, TOKEN_MINUS, VALUE_FLOAT,
+                   float_val, value_create_float, -, false);
+      NEXT();
+    CASE(OP_MULTIPLY_FLOAT):
+      QUICK_BINARY(OP_MULTIPLY_FLOAT, OP_MULTIPLY, TOKEN_MULTIPLY, VALUE_FLOAT,
+                   float_val, value_create_float, *, false);
+      NEXT();
+    CASE(OP_DIVIDE_FLOAT):
+      QUICK_BINARY(OP_DIVIDE_FLOAT, OP_DIVIDE, TOKEN_DIVIDE, VALUE_FLOAT,
+                   float_val, value_create_float, /, true);
+      NEXT();
+
+    CASE(OP_NEGATE):
+    CASE(OP_UNARY): {
+      TokenType operator =
+          ip[-1] == OP_NEGATE ? TOKEN_MINUS : (TokenType)READ_BYTE();
+      Value operand = POP();
+      Value result =
+          interpreter_unary_operation(operator, operand, CURRENT_POS());
+      value_destroy(operand);
+      if (value_is_none(result))
+        goto runtime_error;
+      PUSH(result);
+      NEXT();
+    }
+
+    CASE(OP_FORMAT): {
+      const FormatTemplate *format = frame->chunk->formats[READ_SHORT()];
+      int count = READ_SHORT();
+      sp -= count;
+      String *text = interpreter_render_format(format, sp, count);
+      for (int i = 0; i < count; i++) {
+        value_destroy(sp[i]);
+      }
+      if (!text)
+        goto runtime_error;
+      PUSH(value_from_string(text));
+      NEXT();
+    }
+
+    CASE(OP_PRINT):
+    CASE(OP_PRINTLN): {
+      bool newline = ip[-1] == OP_PRINTLN;
+      Value value = POP();
+      value_print(value);
+      if (newline) {
+        printf("\n");
+      }
+      value_destroy(value);
+      NEXT();
+    }
+
+    CASE(OP_LOOKUP_CALLEE):
+    CASE(OP_LOOKUP_LOCAL_CALLEE): {
+      bool local = ip[-1] == OP_LOOKUP_LOCAL_CALLEE;
+      Symbol *name = frame->chunk->names[READ_SHORT()];
+      EnvSlot where = ENV_SLOT_DYNAMIC;
+      if (local) {
+        where.depth = READ_BYTE();
+        where.slot = READ_SHORT();
+      }
+      int argc = READ_SHORT();
+      CallCache *cache = &frame->chunk->call_caches[READ_SHORT()];
+      Function *func = interpreter_resolve_callee(interpreter, name, where, argc,
+                                                  cache, CURRENT_POS());
+      if (!func)
+        goto runtime_error;
+      vm->callees[vm->callee_top++] = func;
+      NEXT();
+    }
+
+    CASE(OP_CHECK_ARG): {
+      int index = READ_SHORT();
+      Function *func = vm->callees[vm->callee_top - 1];
+      if (!interpreter_bind_argument(func, index, sp[-1], CURRENT_POS()))
+        goto runtime_error;
+      NEXT();
+    }
+
+    CASE(OP_CALL): {
+      int argc = READ_SHORT();
+      Function *func = vm->callees[--vm->callee_top];
+      Position call_pos = CURRENT_POS();
+
+      // The bottom frame is the program itself, not a call.
+      SAVE_STATE();
+      if (vm->frame_count > interpreter->max_call_depth) {
+        interpreter_report_overflow(interpreter, call_pos);
+        vm_abort(vm);
+        return;
+      }
+
+      frame = NULL;
+      if (vm_reserve(vm, func->chunk->max_stack, func->chunk->max_callees))
+        frame = vm_push_frame(vm);
+      if (!frame) {
+        vm_report_out_of_memory(vm, call_pos);
+        vm_abort(vm);
+        return;
+      }
+      frame->func = func;
+      frame->chunk = func->chunk;
+      frame->ip = func->chunk->code;
+      frame->base = (int)(vm->stack_top - vm->stack) - argc;
+      frame->callee_base = vm->callee_top;
+      frame->argc = argc;
+      frame->saved_env = interpreter->current_env;
+      frame->call_pos = call_pos;
+
+      ip = frame->ip;
+      sp = vm->stack_top;
+      NEXT();
+    }
+
+    CASE(OP_DEFAULT_ARG): {
+      int index = READ_SHORT();
+      uint16_t jump = READ_SHORT();
+      if (index < frame->argc) {
+        ip += jump;
+      }
+      NEXT();
+    }
+
+    CASE(OP_CHECK_PARAM): {
+      int index = READ_SHORT();
+      if (!interpreter_bind_argument(frame->func, index, sp[-1], frame->call_pos))
+        goto runtime_error;
+      NEXT();
+    }
+
+    CASE(OP_ENTER): {
+      Function *func = frame->func;
+      Environment *func_env = environment_push(
+          interpreter->scopes, interpreter->current_env, func->param_count);
+      Value *args = vm->stack + frame->base;
+
+      for (int i = 0; i < func->param_count; i++) {
+        environment_define_slot_take(func_env, i, func->param_names[i],
+                                     &args[i], func->param_types[i], false);
+        value_destroy(args[i]);
+      }
+      sp = args;
+      interpreter->current_env = func_env;
+      INTERPRETER_COUNT(interpreter, scopes_created);
+      NEXT();
+    }
+
+    CASE(OP_PUSH_SCOPE): {
+      uint16_t size = READ_SHORT();
+      interpreter->current_env =
+          environment_push(interpreter->scopes, interpreter->current_env,
+                           size == NO_OPERAND ? 0 : size);
+      INTERPRETER_COUNT(interpreter, scopes_created);
+      NEXT();
+    }
+
+    CASE(OP_POP_SCOPE): {
+      Environment *scope = interpreter->current_env;
+      interpreter->current_env = scope->parent;
+      environment_pop(interpreter->scopes, scope);
+      NEXT();
+    }
+
+    CASE(OP_SCOPE_ELIDED):
+      INTERPRETER_COUNT(interpreter, scopes_elided);
+      NEXT();
+
+    CASE(OP_DEFINE_FUNCTION): {
+      FunctionProto *proto = &frame->chunk->functions[READ_SHORT()];
+      uint16_t slot = READ_SHORT();
+      interpreter_declare_function(interpreter, proto->declaration,
+                                   slot == NO_OPERAND ? -1 : slot,
+                                   proto->chunk);
+      NEXT();
+    }
+
+    CASE(OP_RETURN):
+    CASE(OP_RETURN_NOTHING): {
+      Value value = ip[-1] == OP_RETURN ? POP() : value_none();
+      SAVE_STATE();
+
+      if (!frame->func) {
+        // Top-level return stops the program, as in the tree walker.
+        value_destroy(interpreter->return_value);
+        interpreter->return_value = value;
+        interpreter->return_flag = true;
+        vm_abort(vm);
+        return;
+      }
+
+      Function *func = frame->func;
+      vm_pop_frame(vm);
+      LOAD_STATE();
+
+      Value result = interpreter_complete_call(func, value);
+      if (value_is_none(result))
+        goto runtime_error;
+      PUSH(result);
+      NEXT();
+    }
+
+    CASE(OP_HALT):
+      SAVE_STATE();
+      vm_pop_frame(vm);
+      return;
+
+    CASE(OP_COUNT):
+      NEXT();
+    }
+    continue;
+
+  runtime_error:
+    SAVE_STATE();
+    if (!vm_recover(vm))
+      return;
+    LOAD_STATE();
+  }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef CURRENT_POS
+#undef PUSH
+#undef POP
+#undef SAVE_STATE
+#undef LOAD_STATE
+#undef BINARY_OP
+#undef DEOPTIMIZE
+#undef QUICK_BINARY
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+}
+
+Chunk **vm_take_programs(VM *vm, int *count) {
+  Chunk **programs = vm->programs;
+  *count = vm->program_count;
+  vm->programs = NULL;
+  vm->program_count = 0;
+  vm->program_capacity = 0;
+  return programs;
+}
+
+void vm_run_program(VM *vm, ASTNode *program) {
+  Interpreter *interpreter = vm->interpreter;
+  int first = vm->program_count;
+
+  // The whole program is compiled before any of it runs, so a compile error
+  // in a later chunk still stops it from starting.
+  int next = 0;
+  do {
+    Chunk *chunk = compiler_compile(program, &next, interpreter->collect_stats);
+    if (!chunk) {
+      while (vm->program_count > first) {
+        chunk_destroy(vm->programs[--vm->program_count]);
+      }
+      return;
+    }
+
+    if (vm->program_count >= vm->program_capacity) {
+      vm->program_capacity = vm->program_capacity ? vm->program_capacity * 2 : 4;
+      vm->programs = realloc(vm->programs, sizeof(Chunk *) * vm->program_capacity);
+    }
+    vm->programs[vm->program_count++] = chunk;
+  } while (next < program->program.statement_count);
+
+  for (int i = first; i < vm->program_count; i++) {
+    if (i > first && (interpreter->return_flag || interpreter->halted))
+      break;
+    vm_execute(vm, vm->programs[i]);
+  }
+}
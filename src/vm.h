@@ -0,0 +1,61 @@
+#ifndef VM_H
+#define VM_H
+
+#include "bytecode.h"
+#include "interpreter.h"
+
+// The dispatch loop threads its handlers together with labels as values
+// where the compiler supports them. `make DISPATCH=switch` selects the
+// portable switch loop instead.
+#if defined(__GNUC__) && !defined(LIZARD_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#define VM_DISPATCH_NAME "computed goto"
+#else
+#define VM_DISPATCH_NAME "switch"
+#endif
+
+#define VM_FRAMES_INITIAL 64
+#define VM_STACK_INITIAL 1024
+
+typedef struct {
+  Function *func;         // NULL for the top-level program
+  Chunk *chunk;
+  uint8_t *ip;
+  int base;               // First operand stack slot owned by this frame
+  int callee_base;
+  int argc;
+  Environment *saved_env; // Caller's scope, restored on return
+  Position call_pos;
+} CallFrame;
+
+typedef struct VM {
+  Interpreter *interpreter;
+
+  Value *stack;           // Preallocated; grown only when a call needs more
+  Value *stack_top;
+  int stack_capacity;
+
+  Function **callees;
+  int callee_top;
+  int callee_capacity;
+
+  // Lizard calls push a frame here rather than recursing in C, so call
+  // depth is bounded by Interpreter.max_call_depth and memory, not by the
+  // native stack. Grown on demand; pointers into it do not survive a call.
+  CallFrame *frames;
+  int frame_count;
+  int frame_capacity;
+
+  Chunk **programs;       // Kept alive: functions outlive the program run
+  int program_count;
+  int program_capacity;
+} VM;
+
+VM *vm_create(Interpreter *interpreter);
+void vm_destroy(VM *vm);
+void vm_run_program(VM *vm, ASTNode *program);
+// Hands the programs run so far to the caller, who must keep them until no
+// function they define can be called and then free each with chunk_destroy.
+Chunk **vm_take_programs(VM *vm, int *count);
+
+#endif